@@ -0,0 +1,164 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <limits>
+#include "glm/gtc/type_ptr.hpp"
+
+#include "resources/shaders/Intersect.h"
+
+//Padding added to every primitive's bounds so rounding in the intersection tests
+// can never place a hit just outside the box that should contain it.
+#define BOUNDS_EPSILON 0.001f
+
+BVH::BVH()
+	: triangleCount(0)
+{
+
+}
+
+void BVH::build(const TriangleStore& inTriangles, const std::vector<glm::vec4>& inSphereOrigins, const std::vector<float>& inSphereRadius)
+{
+	nodes.clear();
+	primitiveIndices.clear();
+
+	triangleCount = inTriangles.getCount();
+	int primitiveCount = triangleCount + (int)inSphereOrigins.size();
+
+	if (primitiveCount == 0)
+		return;
+
+	//Bounds of each primitive
+	primitiveMin.resize(primitiveCount);
+	primitiveMax.resize(primitiveCount);
+
+	for (int triIndex = 0; triIndex < triangleCount; triIndex++)
+	{
+		//Rebuilt from the edges, any rounding is well inside the bounds padding
+		glm::vec3 v0, edge1, edge2;
+		inTriangles.getTriangle(triIndex, &v0.x, &edge1.x, &edge2.x);
+		glm::vec3 v1 = v0 + edge1;
+		glm::vec3 v2 = v0 + edge2;
+
+		primitiveMin[triIndex] = glm::min(glm::min(v0, v1), v2) - glm::vec3(BOUNDS_EPSILON);
+		primitiveMax[triIndex] = glm::max(glm::max(v0, v1), v2) + glm::vec3(BOUNDS_EPSILON);
+	}
+
+	for (unsigned int sphereIndex = 0; sphereIndex < inSphereOrigins.size(); sphereIndex++)
+	{
+		glm::vec3 origin = glm::vec3(inSphereOrigins[sphereIndex]);
+		glm::vec3 radius = glm::vec3(inSphereRadius[sphereIndex] + BOUNDS_EPSILON);
+
+		primitiveMin[triangleCount + sphereIndex] = origin - radius;
+		primitiveMax[triangleCount + sphereIndex] = origin + radius;
+	}
+
+	primitiveIndices.resize(primitiveCount);
+	for (int primitiveIndex = 0; primitiveIndex < primitiveCount; primitiveIndex++)
+	{
+		primitiveIndices[primitiveIndex] = primitiveIndex;
+	}
+
+	//A binary tree with at least one primitive per leaf never needs more than 2n - 1 nodes
+	nodes.reserve(primitiveCount * 2);
+
+	BVHNode root;
+	root.leftOrFirst = 0;
+	root.primitiveCount = primitiveCount;
+	nodes.push_back(root);
+
+	updateNodeBounds(0);
+	subdivide(0, 0);
+
+	primitiveMin.clear();
+	primitiveMax.clear();
+}
+
+void BVH::updateNodeBounds(int nodeIndex)
+{
+	BVHNode& node = nodes[nodeIndex];
+
+	node.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+	node.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+
+	for (int i = 0; i < node.primitiveCount; i++)
+	{
+		int primitive = primitiveIndices[node.leftOrFirst + i];
+
+		node.boundsMin = glm::min(node.boundsMin, primitiveMin[primitive]);
+		node.boundsMax = glm::max(node.boundsMax, primitiveMax[primitive]);
+	}
+}
+
+void BVH::subdivide(int nodeIndex, int depth)
+{
+	int first = nodes[nodeIndex].leftOrFirst;
+	int count = nodes[nodeIndex].primitiveCount;
+
+	if (count <= MAX_LEAF_SIZE || depth >= MAX_DEPTH - 1)
+		return;
+
+	//Split along the axis the primitive centres are most spread out on
+	glm::vec3 centroidMin = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 centroidMax = glm::vec3(-std::numeric_limits<float>::max());
+
+	for (int i = first; i < first + count; i++)
+	{
+		glm::vec3 centroid = (primitiveMin[primitiveIndices[i]] + primitiveMax[primitiveIndices[i]]) * 0.5f;
+		centroidMin = glm::min(centroidMin, centroid);
+		centroidMax = glm::max(centroidMax, centroid);
+	}
+
+	glm::vec3 extent = centroidMax - centroidMin;
+	int axis = 0;
+	if (extent.y > extent.x)
+		axis = 1;
+	if (extent.z > extent[axis])
+		axis = 2;
+
+	//Object median split, keeps the tree balanced so the depth stays at log2(n)
+	int half = count / 2;
+	auto centroidLess = [this, axis](int a, int b)
+	{
+		return (primitiveMin[a][axis] + primitiveMax[a][axis]) < (primitiveMin[b][axis] + primitiveMax[b][axis]);
+	};
+
+	std::nth_element(primitiveIndices.begin() + first, primitiveIndices.begin() + first + half,
+		primitiveIndices.begin() + first + count, centroidLess);
+
+	//Children are stored next to each other
+	int leftIndex = (int)nodes.size();
+
+	BVHNode left;
+	left.leftOrFirst = first;
+	left.primitiveCount = half;
+	nodes.push_back(left);
+
+	BVHNode right;
+	right.leftOrFirst = first + half;
+	right.primitiveCount = count - half;
+	nodes.push_back(right);
+
+	nodes[nodeIndex].leftOrFirst = leftIndex;
+	nodes[nodeIndex].primitiveCount = 0;
+
+	updateNodeBounds(leftIndex);
+	updateNodeBounds(leftIndex + 1);
+
+	subdivide(leftIndex, depth + 1);
+	subdivide(leftIndex + 1, depth + 1);
+}
+
+bool BVH::intersectBounds(const BVHNode& node, const Ray& ray, float maxDistance, float& entryDistance)
+{
+	//The same slab test the OpenCL kernel runs
+	return Intersect::intersectBounds(glm::value_ptr(node.boundsMin), glm::value_ptr(node.boundsMax),
+		glm::value_ptr(ray.origin), glm::value_ptr(ray.direction), maxDistance, &entryDistance) == 1;
+}
+
+size_t BVH::getMemoryUsage() const
+{
+	return nodes.capacity() * sizeof(BVHNode)
+		+ primitiveIndices.capacity() * sizeof(int)
+		+ primitiveMin.capacity() * sizeof(glm::vec3)
+		+ primitiveMax.capacity() * sizeof(glm::vec3);
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "glm/glm.hpp"
+#include <vector>
+
+#include "Ray.h"
+#include "TriangleStore.h"
+
+/**
+ @brief	A node of the flattened bounding volume hierarchy.
+	Children are always stored next to each other, so only the left child index is kept.
+	The layout is mirrored by struct BVHNode in rayTracer.cl so the nodes can be uploaded as is.
+ */
+struct BVHNode
+{
+	/** @brief	The minimum corner of the bounding box. */
+	glm::vec3 boundsMin;
+	/** @brief	Index of the left child for interior nodes, or the first primitive for leaves. */
+	int leftOrFirst;
+	/** @brief	The maximum corner of the bounding box. */
+	glm::vec3 boundsMax;
+	/** @brief	Number of primitives in a leaf, 0 for interior nodes. */
+	int primitiveCount;
+};
+
+static_assert(sizeof(BVHNode) == 32, "BVHNode must match the layout used by the OpenCL kernel");
+
+/**
+ @brief	A bounding volume hierarchy over the cube triangles and spheres of a scene.
+	Primitives are numbered with all cube triangles first (in cube order) followed by the spheres,
+	which matches the order the linear intersection loop used to test them in.
+ */
+class BVH
+{
+public:
+
+	/**
+	 @brief	The maximum depth of the hierarchy, traversal stacks must be at least this big.
+		Kept small as the OpenCL kernel holds its stack in private memory.
+	 */
+	static const int MAX_DEPTH = 32;
+
+	/** @brief	Default constructor. */
+	BVH();
+
+	/**
+	 @brief	Builds the hierarchy, replacing any previous one.
+
+	 @param	inTriangles	   	The cube triangles.
+	 @param	inSphereOrigins	The sphere origins.
+	 @param	inSphereRadius 	The sphere radius.
+	 */
+	void build(const TriangleStore& inTriangles, const std::vector<glm::vec4>& inSphereOrigins, const std::vector<float>& inSphereRadius);
+
+	/**
+	 @brief	Tests a ray against a node's bounding box.
+
+	 @param 			node		 	The node.
+	 @param 			ray			 	The ray.
+	 @param 			maxDistance  	The distance past which hits are not wanted.
+	 @param [in,out]	entryDistance	The distance the ray enters the box at.
+
+	 @return	true if the ray passes through the box before maxDistance.
+	 */
+	static bool intersectBounds(const BVHNode& node, const Ray& ray, float maxDistance, float& entryDistance);
+
+	/**
+	 @brief	Gets the nodes, index 0 is the root.
+
+	 @return	The nodes.
+	 */
+	const std::vector<BVHNode>& getNodes() const { return nodes; }
+
+	/**
+	 @brief	Gets the primitive indices referenced by the leaves.
+
+	 @return	The primitive indices.
+	 */
+	const std::vector<int>& getPrimitiveIndices() const { return primitiveIndices; }
+
+	/**
+	 @brief	Gets the number of triangles, primitive indices at or above this are spheres.
+
+	 @return	The triangle count.
+	 */
+	int getTriangleCount() const { return triangleCount; }
+
+	/**
+	 @brief	Query if the hierarchy contains no primitives.
+
+	 @return	true if empty, false if not.
+	 */
+	bool isEmpty() const { return nodes.empty(); }
+
+	/**
+	 @brief	Gets the memory held by the hierarchy, including the build data kept for reuse.
+	
+	 @return	The memory in bytes.
+	 */
+	size_t getMemoryUsage() const;
+
+private:
+
+	/** @brief	The maximum number of primitives stored in a leaf. */
+	static const int MAX_LEAF_SIZE = 4;
+
+	/** @brief	The flattened nodes. */
+	std::vector<BVHNode> nodes;
+
+	/** @brief	The primitive indices, each leaf references a contiguous range. */
+	std::vector<int> primitiveIndices;
+
+	/** @brief	Number of triangles the hierarchy was built over. */
+	int triangleCount;
+
+	//Build data, only valid during build()
+	/** @brief	The bounds minimum of each primitive. */
+	std::vector<glm::vec3> primitiveMin;
+	/** @brief	The bounds maximum of each primitive. */
+	std::vector<glm::vec3> primitiveMax;
+
+	/**
+	 @brief	Calculates the bounds of a node from the primitives it holds.
+
+	 @param	nodeIndex	Zero-based index of the node.
+	 */
+	void updateNodeBounds(int nodeIndex);
+
+	/**
+	 @brief	Recursively splits a node until its leaves are small enough.
+
+	 @param	nodeIndex	Zero-based index of the node.
+	 @param	depth	 	The depth of the node.
+	 */
+	void subdivide(int nodeIndex, int depth);
+};
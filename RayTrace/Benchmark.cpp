@@ -0,0 +1,366 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "PacketIntersect.h"
+#include "misc/Log.h"
+#include "misc/PerformanceCounter.h"
+#include "misc/Random.h"
+#include "misc/Utility.h"
+
+bool Benchmark::isRequested(int argc, char** argv)
+{
+	for (int argIndex = 1; argIndex < argc; argIndex++)
+	{
+		if (std::string(argv[argIndex]) == "--benchmark")
+			return true;
+	}
+
+	return false;
+}
+
+int Benchmark::run(int argc, char** argv)
+{
+	int warmup = 2;
+	int repeats = 10;
+	unsigned int seed = 1;
+	std::string output = "benchmark.json";
+	std::string device = "auto";
+	std::string fission = "none";
+	std::vector<RayTracer::Mode> modes = { RayTracer::CPU, RayTracer::CPUParallel, RayTracer::OpenCL };
+	std::vector<std::pair<int, int>> resolutions = { std::make_pair(640, 480) };
+	std::vector<int> syntheticObjectCounts = { 400, 1600, 6400 };
+
+	for (int argIndex = 1; argIndex < argc; argIndex++)
+	{
+		std::string arg = argv[argIndex];
+
+		if (arg == "--benchmark")
+			continue;
+
+		//Every other option takes a value
+		if (argIndex + 1 >= argc)
+		{
+			Log::logE("Missing value for " + arg);
+			printUsage();
+			return 1;
+		}
+
+		std::string value = argv[++argIndex];
+
+		if (arg == "--warmup")
+			warmup = atoi(value.c_str());
+		else if (arg == "--repeats")
+			repeats = atoi(value.c_str());
+		else if (arg == "--seed")
+			seed = (unsigned int)strtoul(value.c_str(), nullptr, 10);
+		else if (arg == "--output")
+			output = value;
+		else if (arg == "--device")
+			device = value;
+		else if (arg == "--fission")
+			fission = value;
+		else if (arg == "--modes")
+		{
+			modes.clear();
+			for (auto& name : split(value))
+			{
+				RayTracer::Mode mode;
+				if (!RayTracer::parseModeArgument(name, mode))
+				{
+					Log::logE("Unknown mode " + name);
+					printUsage();
+					return 1;
+				}
+				modes.push_back(mode);
+			}
+		}
+		else if (arg == "--resolutions")
+		{
+			resolutions.clear();
+			for (auto& resolution : split(value))
+			{
+				int width = 0;
+				int height = 0;
+				size_t separator = resolution.find('x');
+				if (separator != std::string::npos)
+				{
+					width = atoi(resolution.substr(0, separator).c_str());
+					height = atoi(resolution.substr(separator + 1).c_str());
+				}
+
+				if (width <= 0 || height <= 0)
+				{
+					Log::logE("Invalid resolution " + resolution + ", expected WIDTHxHEIGHT");
+					return 1;
+				}
+				resolutions.push_back(std::make_pair(width, height));
+			}
+		}
+		else if (arg == "--synthetic")
+		{
+			syntheticObjectCounts.clear();
+			for (auto& count : split(value))
+			{
+				if (atoi(count.c_str()) > 0)
+					syntheticObjectCounts.push_back(atoi(count.c_str()));
+			}
+		}
+		else
+		{
+			Log::logE("Unknown option " + arg);
+			printUsage();
+			return 1;
+		}
+	}
+
+	if (warmup < 0 || repeats <= 0)
+	{
+		Log::logE("Warmup can't be negative and repeats must be above 0");
+		return 1;
+	}
+
+	PerformanceCounter::initSubsystem();
+	PacketIntersect::init();
+
+	std::vector<Result> results;
+	unsigned int threads = 0;
+	std::string deviceName;
+
+	for (auto& resolution : resolutions)
+	{
+		RayTracer rayTracer(resolution.first, resolution.second, device, fission);
+		threads = rayTracer.getThreadCount();
+		deviceName = rayTracer.getOpenCLDeviceName();
+
+		//Scenes 1-3 then the synthetic ones, negative numbers mark the synthetic object counts
+		std::vector<int> scenes = { 1, 2, 3 };
+		for (int objectCount : syntheticObjectCounts)
+		{
+			scenes.push_back(-objectCount);
+		}
+
+		for (int scene : scenes)
+		{
+			//Reseed so every resolution and build gets exactly the same scene
+			Random::init(seed);
+
+			std::string sceneName;
+			if (scene > 0)
+			{
+				rayTracer.setScene(scene);
+				sceneName = "scene" + Utility::intToString(scene);
+			}
+			else
+			{
+				rayTracer.setSyntheticScene(-scene);
+				sceneName = "synthetic" + Utility::intToString(-scene);
+			}
+
+			for (RayTracer::Mode mode : modes)
+			{
+				Result result;
+				result.scene = sceneName;
+				result.mode = mode;
+				result.width = resolution.first;
+				result.height = resolution.second;
+				result.ran = !(RayTracer::isOpenCLMode(mode) && !rayTracer.isOpenCLAvailable());
+
+				if (result.ran)
+				{
+					//Warmup also covers one off costs like uploading the scene to the device
+					for (int warmupIndex = 0; warmupIndex < warmup; warmupIndex++)
+					{
+						rayTracer.render(mode);
+					}
+
+					for (int repeatIndex = 0; repeatIndex < repeats; repeatIndex++)
+					{
+						rayTracer.render(mode);
+						result.samples.push_back(rayTracer.getTimeTaken());
+					}
+				}
+
+				result.residentBytes = MemoryCounter::getResidentMemory();
+				result.peakResidentBytes = MemoryCounter::getPeakResidentMemory();
+				for (int subsystem = 0; subsystem < MemoryCounter::SubsystemCount; subsystem++)
+				{
+					result.subsystemBytes[subsystem] = MemoryCounter::getSubsystemBytes((MemoryCounter::Subsystem)subsystem);
+				}
+
+				calculateStatistics(result);
+				results.push_back(result);
+			}
+		}
+	}
+
+	//Summary table
+	std::cout << std::endl << std::left
+		<< std::setw(16) << "Scene" << std::setw(14) << "Mode" << std::setw(12) << "Resolution"
+		<< std::setw(12) << "Min (us)" << std::setw(12) << "Median (us)" << std::setw(12) << "P95 (us)" << std::endl;
+
+	for (auto& result : results)
+	{
+		std::cout << std::setw(16) << result.scene << std::setw(14) << RayTracer::getModeArgument(result.mode)
+			<< std::setw(12) << (Utility::intToString(result.width) + "x" + Utility::intToString(result.height));
+
+		if (result.ran)
+			std::cout << std::setw(12) << result.min << std::setw(12) << result.median << std::setw(12) << result.p95 << std::endl;
+		else
+			std::cout << "skipped" << std::endl;
+	}
+
+	if (!writeJSON(output, results, warmup, repeats, seed, threads, deviceName, fission))
+		return 1;
+
+	std::cout << std::endl << "Results written to " << output << std::endl;
+	return 0;
+}
+
+void Benchmark::calculateStatistics(Result& result)
+{
+	result.min = result.median = result.p95 = result.mean = 0;
+
+	if (result.samples.empty())
+		return;
+
+	std::sort(result.samples.begin(), result.samples.end());
+	size_t count = result.samples.size();
+
+	result.min = result.samples[0];
+
+	if (count % 2 == 1)
+		result.median = result.samples[count / 2];
+	else
+		result.median = (result.samples[(count / 2) - 1] + result.samples[count / 2]) / 2;
+
+	//Nearest rank, so with few repeats this is the slowest one
+	size_t p95Rank = (count * 95 + 99) / 100;
+	result.p95 = result.samples[p95Rank - 1];
+
+	uint64_t total = 0;
+	for (uint64_t sample : result.samples)
+	{
+		total += sample;
+	}
+	result.mean = total / count;
+}
+
+bool Benchmark::writeJSON(std::string path, const std::vector<Result>& results, int warmup, int repeats, unsigned int seed, unsigned int threads, std::string deviceName, std::string fission)
+{
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+
+	if (!file.is_open())
+	{
+		Log::logE("Benchmark results couldn't be written to " + path);
+		return false;
+	}
+
+	file << "{" << std::endl;
+	file << "\t\"timestamp\": " << (long long)time(NULL) << "," << std::endl;
+	file << "\t\"instructionSet\": \"" << escapeJSON(PacketIntersect::getInstructionSetName()) << "\"," << std::endl;
+	file << "\t\"threads\": " << threads << "," << std::endl;
+	file << "\t\"openCLDevice\": \"" << escapeJSON(deviceName) << "\"," << std::endl;
+	file << "\t\"openCLFission\": \"" << escapeJSON(fission) << "\"," << std::endl;
+	file << "\t\"warmup\": " << warmup << "," << std::endl;
+	file << "\t\"repeats\": " << repeats << "," << std::endl;
+	file << "\t\"seed\": " << seed << "," << std::endl;
+	file << "\t\"unit\": \"microseconds\"," << std::endl;
+	file << "\t\"results\": [" << std::endl;
+
+	for (size_t resultIndex = 0; resultIndex < results.size(); resultIndex++)
+	{
+		const Result& result = results[resultIndex];
+
+		file << "\t\t{ \"scene\": \"" << escapeJSON(result.scene) << "\", \"mode\": \"" << RayTracer::getModeArgument(result.mode) << "\", "
+			<< "\"width\": " << result.width << ", \"height\": " << result.height << ", "
+			<< "\"memory\": { \"residentBytes\": " << result.residentBytes << ", \"peakResidentBytes\": " << result.peakResidentBytes
+			<< ", \"sceneBytes\": " << result.subsystemBytes[MemoryCounter::Scene]
+			<< ", \"frameBufferBytes\": " << result.subsystemBytes[MemoryCounter::FrameBuffer]
+			<< ", \"deviceBufferBytes\": " << result.subsystemBytes[MemoryCounter::DeviceBuffers] << " }, ";
+
+		if (result.ran)
+		{
+			file << "\"status\": \"ok\", \"min\": " << result.min << ", \"median\": " << result.median
+				<< ", \"p95\": " << result.p95 << ", \"mean\": " << result.mean << ", \"samples\": [";
+
+			for (size_t sampleIndex = 0; sampleIndex < result.samples.size(); sampleIndex++)
+			{
+				file << (sampleIndex > 0 ? ", " : "") << result.samples[sampleIndex];
+			}
+
+			file << "] }";
+		}
+		else
+		{
+			file << "\"status\": \"skipped\" }";
+		}
+
+		file << ((resultIndex + 1 < results.size()) ? "," : "") << std::endl;
+	}
+
+	file << "\t]" << std::endl;
+	file << "}" << std::endl;
+
+	return true;
+}
+
+std::string Benchmark::escapeJSON(std::string str)
+{
+	std::string escaped;
+
+	for (unsigned char character : str)
+	{
+		if (character == '"' || character == '\\')
+		{
+			escaped += '\\';
+			escaped += character;
+		}
+		else if (character < 0x20)
+		{
+			//Control characters can only be written as unicode escapes
+			char unicodeEscape[8];
+			snprintf(unicodeEscape, sizeof(unicodeEscape), "\\u%04x", character);
+			escaped += unicodeEscape;
+		}
+		else
+		{
+			escaped += character;
+		}
+	}
+
+	return escaped;
+}
+
+std::vector<std::string> Benchmark::split(std::string list)
+{
+	std::vector<std::string> items;
+	size_t start = 0;
+
+	while (start <= list.size())
+	{
+		size_t end = list.find(',', start);
+		if (end == std::string::npos)
+			end = list.size();
+
+		if (end > start)
+			items.push_back(list.substr(start, end - start));
+
+		start = end + 1;
+	}
+
+	return items;
+}
+
+void Benchmark::printUsage()
+{
+	Log::logI("Usage: RayTrace --benchmark [--warmup N] [--repeats N] [--modes cpu,cpu-parallel,opencl] "
+		"[--resolutions 640x480,1920x1080] [--synthetic 400,1600,6400] [--seed S] [--output benchmark.json] "
+		"[--device auto|gpu|cpu|accelerator|index|name] [--fission none|numa|N]");
+}
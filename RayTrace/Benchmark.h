@@ -0,0 +1,117 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "RayTracer.h"
+#include "misc/MemoryCounter.h"
+
+/**
+@brief	Runs every scene through every mode at every resolution and reports timing statistics as JSON.
+	Usage: RayTrace --benchmark [--warmup N] [--repeats N] [--modes cpu,cpu-parallel,opencl]
+		[--resolutions 640x480,1920x1080] [--synthetic 400,1600,6400] [--seed S] [--output benchmark.json]
+		[--device auto|gpu|cpu|accelerator|index|name] [--fission none|numa|N]
+	Scenes 1 to 3 are always run, followed by a synthetic scene for each object count given.
+	The random scenes are seeded the same way every run so results can be compared between builds.
+*/
+class Benchmark
+{
+public:
+
+	/**
+	 @brief	Query if the command line asks for a benchmark.
+	
+	 @param	argc	The number of command-line arguments.
+	 @param	argv	The command-line arguments.
+	
+	 @return	true if --benchmark was passed.
+	 */
+	static bool isRequested(int argc, char** argv);
+
+	/**
+	 @brief	Parses the command line, runs the benchmark and writes the results.
+	
+	 @param	argc	The number of command-line arguments.
+	 @param	argv	The command-line arguments.
+	
+	 @return	The exit code, 0 on success.
+	 */
+	static int run(int argc, char** argv);
+
+private:
+
+	/** @brief	The timings of one scene, mode and resolution. */
+	struct Result
+	{
+		/** @brief	The scene name. */
+		std::string scene;
+		/** @brief	The mode. */
+		RayTracer::Mode mode;
+		/** @brief	The width. */
+		int width;
+		/** @brief	The height. */
+		int height;
+		/** @brief	False if the mode couldn't run (e.g. no OpenCL). */
+		bool ran;
+		/** @brief	The time of each repeat in microseconds, sorted. */
+		std::vector<uint64_t> samples;
+		/** @brief	The fastest repeat. */
+		uint64_t min;
+		/** @brief	The median repeat. */
+		uint64_t median;
+		/** @brief	The 95th percentile repeat. */
+		uint64_t p95;
+		/** @brief	The mean of the repeats. */
+		uint64_t mean;
+		/** @brief	The resident memory in bytes after the last repeat. */
+		long long residentBytes;
+		/** @brief	The peak resident memory in bytes after the last repeat. */
+		long long peakResidentBytes;
+		/** @brief	The bytes counted for each MemoryCounter subsystem after the last repeat. */
+		long long subsystemBytes[MemoryCounter::SubsystemCount];
+	};
+
+	/**
+	 @brief	Sorts the samples and calculates the statistics.
+	
+	 @param [in,out]	result	The result, with its samples filled in.
+	 */
+	static void calculateStatistics(Result& result);
+
+	/**
+	 @brief	Writes the results as JSON.
+	
+	 @param	path   	The file to write.
+	 @param	results	The results.
+	 @param	warmup 	The number of warmup renders.
+	 @param	repeats	The number of timed renders.
+	 @param	seed   	The random seed.
+	 @param	threads	The number of threads used by the parallel CPU mode.
+	 @param	deviceName	The name of the OpenCL device, empty if there isn't one.
+	 @param	fission   	How the OpenCL device was split into sub-devices.
+	
+	 @return	true if the file was written.
+	 */
+	static bool writeJSON(std::string path, const std::vector<Result>& results, int warmup, int repeats, unsigned int seed, unsigned int threads, std::string deviceName, std::string fission);
+
+	/**
+	 @brief	Escapes a string to be written inside quotes in JSON.
+	
+	 @param	str	The string.
+	
+	 @return	The escaped string.
+	 */
+	static std::string escapeJSON(std::string str);
+
+	/**
+	 @brief	Splits a comma separated list.
+	
+	 @param	list	The list.
+	
+	 @return	The items.
+	 */
+	static std::vector<std::string> split(std::string list);
+
+	/** @brief	Prints the usage to the log. */
+	static void printUsage();
+};
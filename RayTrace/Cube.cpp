@@ -3,7 +3,7 @@
 #include "glm/gtc/matrix_transform.hpp"
 #include <iostream>
 
-Cube::Cube(glm::vec4& newColour)
+Cube::Cube(const glm::vec4& newColour)
 	: colour(newColour)
 {
 	triangles.reserve(36);
@@ -45,11 +45,6 @@ Cube::Cube(glm::vec4& newColour)
 	triangles.push_back(glm::vec4(1.0f, -1.0f, 1.0f, 1.0f));
 }
 
-std::vector<glm::vec4> Cube::getTriangles()
-{
-	return triangles;
-}
-
 void Cube::rotate(glm::vec3 newRotation)
 {
 	glm::mat4 rotationMat = glm::rotate(glm::mat4(1.0f), newRotation.z, glm::vec3(0, 0, 1));
@@ -13,14 +13,14 @@ public:
 	
 	 @param [in,out]	colour	The colour.
 	 */
-	Cube(glm::vec4& colour);
+	Cube(const glm::vec4& colour);
 
 	/**
 	 @brief	Gets the triangles that form this cube.
 	
 	 @return	The triangles vertices.
 	 */
-	std::vector<glm::vec4> getTriangles();
+	const std::vector<glm::vec4>& getTriangles() const { return triangles; }
 
 	/**
 	 @brief	Rotates the cube by the given new rotation.
@@ -48,7 +48,7 @@ public:
 	
 	 @return	The colour.
 	 */
-	glm::vec4 getColour() { return colour; }
+	glm::vec4 getColour() const { return colour; }
 private:
 
 	/** @brief	The triangles vertices. */
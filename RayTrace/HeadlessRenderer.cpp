@@ -0,0 +1,178 @@
+#include "HeadlessRenderer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "PacketIntersect.h"
+#include "misc/Log.h"
+#include "misc/PerformanceCounter.h"
+#include "misc/Random.h"
+#include "misc/Utility.h"
+
+bool HeadlessRenderer::isRequested(int argc, char** argv)
+{
+	for (int argIndex = 1; argIndex < argc; argIndex++)
+	{
+		if (std::string(argv[argIndex]) == "--headless")
+			return true;
+	}
+
+	return false;
+}
+
+int HeadlessRenderer::run(int argc, char** argv)
+{
+	int scene = 1;
+	RayTracer::Mode mode = RayTracer::CPU;
+	int width = 640;
+	int height = 480;
+	int runs = 1;
+	unsigned int seed = 0;
+	std::string output = "render.png";
+	std::string workGroup = "driver";
+	std::string device = "auto";
+	std::string fission = "none";
+	RayTracer::Precision precision = RayTracer::Single;
+
+	for (int argIndex = 1; argIndex < argc; argIndex++)
+	{
+		std::string arg = argv[argIndex];
+
+		if (arg == "--headless")
+			continue;
+
+		//Every other option takes a value
+		if (argIndex + 1 >= argc)
+		{
+			Log::logE("Missing value for " + arg);
+			printUsage();
+			return 1;
+		}
+
+		std::string value = argv[++argIndex];
+
+		if (arg == "--scene")
+			scene = atoi(value.c_str());
+		else if (arg == "--mode")
+		{
+			if (!RayTracer::parseModeArgument(value, mode))
+			{
+				Log::logE("Unknown mode " + value);
+				printUsage();
+				return 1;
+			}
+		}
+		else if (arg == "--width")
+			width = atoi(value.c_str());
+		else if (arg == "--height")
+			height = atoi(value.c_str());
+		else if (arg == "--runs")
+			runs = atoi(value.c_str());
+		else if (arg == "--seed")
+			seed = (unsigned int)strtoul(value.c_str(), nullptr, 10);
+		else if (arg == "--output")
+			output = value;
+		else if (arg == "--work-group")
+			workGroup = value;
+		else if (arg == "--device")
+			device = value;
+		else if (arg == "--fission")
+			fission = value;
+		else if (arg == "--precision")
+		{
+			if (!RayTracer::parsePrecisionArgument(value, precision))
+			{
+				Log::logE("Unknown precision " + value);
+				printUsage();
+				return 1;
+			}
+		}
+		else
+		{
+			Log::logE("Unknown option " + arg);
+			printUsage();
+			return 1;
+		}
+	}
+
+	if (width <= 0 || height <= 0 || runs <= 0)
+	{
+		Log::logE("Width, height and runs must be above 0");
+		return 1;
+	}
+
+	//Same start up as the windowed build minus SDL
+	Random::init(seed);
+	PerformanceCounter::initSubsystem();
+	PacketIntersect::init();
+
+	RayTracer rayTracer(width, height, device, fission);
+	rayTracer.setPrecision(precision);
+
+	if (RayTracer::isOpenCLMode(mode) && !rayTracer.isOpenCLAvailable())
+	{
+		Log::logE("OpenCL mode requested but OpenCL is not available");
+		return 1;
+	}
+
+	if (!rayTracer.setScene(scene))
+	{
+		Log::logE("Scene " + Utility::intToString(scene) + " does not exist");
+		return 1;
+	}
+
+	if (RayTracer::isOpenCLMode(mode))
+	{
+		if (workGroup == "auto")
+		{
+			rayTracer.tuneWorkGroupSize();
+		}
+		else if (workGroup != "driver")
+		{
+			size_t separator = workGroup.find('x');
+			bool valid = separator != std::string::npos
+				&& rayTracer.setWorkGroupSize(atoi(workGroup.substr(0, separator).c_str()), atoi(workGroup.substr(separator + 1).c_str()));
+
+			if (!valid)
+			{
+				Log::logE("Invalid work-group size " + workGroup);
+				printUsage();
+				return 1;
+			}
+		}
+	}
+
+	std::vector<uint64_t> times;
+	for (int runIndex = 0; runIndex < runs; runIndex++)
+	{
+		rayTracer.render(mode);
+		times.push_back(rayTracer.getTimeTaken());
+	}
+
+	uint64_t total = 0;
+	for (uint64_t time : times)
+	{
+		total += time;
+	}
+
+	std::cout << "Headless render: scene " << scene << ", " << RayTracer::getModeName(mode) << ", "
+		<< width << "x" << height << ", " << runs << " runs" << std::endl;
+	std::cout << "Min: " << *std::min_element(times.begin(), times.end()) << " microseconds" << std::endl;
+	std::cout << "Max: " << *std::max_element(times.begin(), times.end()) << " microseconds" << std::endl;
+	std::cout << "Mean: " << (total / times.size()) << " microseconds" << std::endl;
+
+	if (!RayTracer::encodePNG(output.c_str(), rayTracer.getPixels(), width, height))
+		return 1;
+
+	std::cout << "Image written to " << output << std::endl;
+	return 0;
+}
+
+void HeadlessRenderer::printUsage()
+{
+	Log::logI("Usage: RayTrace --headless [--scene 1-3] [--mode cpu|cpu-parallel|opencl|opencl-multi|hybrid] [--width W] [--height H] "
+		"[--runs N] [--seed S] [--output image.png] [--work-group WxH|auto|driver] "
+		"[--device auto|gpu|cpu|accelerator|index|name] [--fission none|numa|N] [--precision float|double]");
+}
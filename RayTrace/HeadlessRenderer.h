@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+#include "RayTracer.h"
+
+/**
+@brief	Renders a scene from the command line without creating a window, font or renderer.
+	Usage: RayTrace --headless [--scene 1-3] [--mode cpu|cpu-parallel|opencl] [--width W] [--height H]
+		[--runs N] [--seed S] [--output image.png]
+	Every run is timed and the last image is written as a PNG.
+*/
+class HeadlessRenderer
+{
+public:
+
+	/**
+	 @brief	Query if the command line asks for a headless render.
+	
+	 @param	argc	The number of command-line arguments.
+	 @param	argv	The command-line arguments.
+	
+	 @return	true if --headless was passed.
+	 */
+	static bool isRequested(int argc, char** argv);
+
+	/**
+	 @brief	Parses the command line, renders and writes the image.
+	
+	 @param	argc	The number of command-line arguments.
+	 @param	argv	The command-line arguments.
+	
+	 @return	The exit code, 0 on success.
+	 */
+	static int run(int argc, char** argv);
+
+private:
+
+	/** @brief	Prints the usage to the log. */
+	static void printUsage();
+};
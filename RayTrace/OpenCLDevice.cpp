@@ -0,0 +1,959 @@
+#include "OpenCLDevice.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <cstring>
+
+#include "misc/Utility.h"
+#include "misc/AlignedAllocator.h"
+#include "misc/MemoryCounter.h"
+#include "misc/PerformanceCounter.h"
+
+OpenCLDevice::OpenCLDevice(cl_device_id deviceID)
+	: deviceID(deviceID)
+{
+	context = NULL;
+	cmdQueue = NULL;
+	program = NULL;
+	kernel = NULL;
+
+	//Buffers are created on first use
+	for (int bufferIndex = 0; bufferIndex < BUFFER_COUNT; bufferIndex++)
+	{
+		outputBuffers[bufferIndex] = NULL;
+		hostFrames[bufferIndex] = nullptr;
+
+		bands[bufferIndex].firstRow = 0;
+		bands[bufferIndex].rowCount = 0;
+		bands[bufferIndex].kernelEvent = NULL;
+		bands[bufferIndex].mapEvent = NULL;
+		bands[bufferIndex].unmapEvent = NULL;
+		bands[bufferIndex].pixels = nullptr;
+		bands[bufferIndex].heldPixels = nullptr;
+		bands[bufferIndex].profile = OpenCLProfile();
+		bands[bufferIndex].readyTime = 0;
+	}
+	sphereOriginsBuffer = NULL;
+	sphereRadiusBuffer = NULL;
+	sphereColoursBuffer = NULL;
+	trianglesBuffer = NULL;
+	cubeColoursBuffer = NULL;
+	bvhNodesBuffer = NULL;
+	bvhPrimitiveIndicesBuffer = NULL;
+	sceneUploaded = false;
+	zeroCopy = false;
+	frameWidth = 0;
+	frameHeight = 0;
+
+	workGroupWidth = 0;
+	workGroupHeight = 0;
+}
+
+OpenCLDevice::~OpenCLDevice()
+{
+	//Collect anything still in flight so every event is released and no buffer is left mapped
+	for (int bufferIndex = 0; bufferIndex < BUFFER_COUNT; bufferIndex++)
+	{
+		if (bands[bufferIndex].rowCount > 0)
+		{
+			std::vector<unsigned char> discardedPixels((sizeof(unsigned char) * 4) * frameWidth * frameHeight);
+			finishBand(bufferIndex, discardedPixels.data());
+		}
+
+		unmapHeldPixels(bufferIndex);
+	}
+
+	if (cmdQueue != NULL)
+		clFinish(cmdQueue);
+
+	for (int bufferIndex = 0; bufferIndex < BUFFER_COUNT; bufferIndex++)
+	{
+		if (bands[bufferIndex].unmapEvent != NULL)
+			clReleaseEvent(bands[bufferIndex].unmapEvent);
+	}
+
+	OpenCLProfile discardedProfile;
+	collectWriteEvents(pendingWriteEvents, discardedProfile);
+
+	releaseFrameBuffers();
+	releaseSceneBuffers();
+
+	if (kernel != NULL)
+		clReleaseKernel(kernel);
+	if (program != NULL)
+		clReleaseProgram(program);
+	if (cmdQueue != NULL)
+		clReleaseCommandQueue(cmdQueue);
+	if (context != NULL)
+		clReleaseContext(context);
+}
+
+bool OpenCLDevice::init(const std::string& source, const std::string& buildOptions)
+{
+	cl_int error = 0;
+
+	//Each device may be on a different platform, so each gets a context for its own platform
+	cl_platform_id platformID = nullptr;
+	clGetDeviceInfo(deviceID, CL_DEVICE_PLATFORM, sizeof(cl_platform_id), &platformID, NULL);
+	cl_context_properties contextProperties[] = { CL_CONTEXT_PLATFORM, (cl_context_properties)platformID, 0 };
+
+	context = clCreateContext(contextProperties, 1, &deviceID, NULL, NULL, &error);
+
+	if (context == NULL)
+	{
+		std::cout << "OpenCL could not create a context, errorcode: " << error << std::endl;
+		return false;
+	}
+
+	//Profiling lets each stage of a render be timed on the device
+	cmdQueue = clCreateCommandQueue(context, deviceID, CL_QUEUE_PROFILING_ENABLE, &error);
+	if (cmdQueue == NULL)
+	{
+		std::cout << "OpenCL could not create a command queue, errorcode: " << error << std::endl;
+		return false;
+	}
+
+	//CPU and integrated devices read and write host memory directly, so their output doesn't need copying back
+	cl_bool hostUnifiedMemory = CL_FALSE;
+	clGetDeviceInfo(deviceID, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(cl_bool), &hostUnifiedMemory, NULL);
+	zeroCopy = (hostUnifiedMemory == CL_TRUE);
+
+	//Compiling can take seconds (especially on CPU runtimes), so reuse the last build if nothing has changed
+	std::string cacheKey = getProgramCacheKey(source, buildOptions);
+	program = loadProgramFromCache(cacheKey, buildOptions);
+
+	if (program == NULL)
+	{
+		const char* sourceData = source.c_str();
+		program = clCreateProgramWithSource(context, 1, &sourceData, NULL, &error);
+		if (program == NULL)
+		{
+			std::cout << "OpenCL could not create a program, errorcode: " << error << std::endl;
+			return false;
+		}
+
+		if (buildProgram(buildOptions))
+			saveProgramToCache(cacheKey);
+	}
+
+	kernel = clCreateKernel(program, "rayTracer", &error);
+	if (kernel == NULL)
+	{
+		std::cout << "OpenCL could not create a kernel, errorcode: " << error << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+std::string OpenCLDevice::getName()
+{
+	char name[1000];
+	if (clGetDeviceInfo(deviceID, CL_DEVICE_NAME, sizeof(name), name, NULL) != CL_SUCCESS)
+		return "";
+
+	return name;
+}
+
+bool OpenCLDevice::setWorkGroupSize(int groupWidth, int groupHeight)
+{
+	if (groupWidth < 0 || groupHeight < 0 || (groupWidth == 0) != (groupHeight == 0))
+	{
+		std::cout << "Invalid work-group size " << groupWidth << "x" << groupHeight << std::endl;
+		return false;
+	}
+
+	if (kernel != NULL && groupWidth > 0)
+	{
+		size_t maxWorkGroupSize = 0;
+		clGetKernelWorkGroupInfo(kernel, deviceID, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &maxWorkGroupSize, NULL);
+
+		if ((size_t)(groupWidth * groupHeight) > maxWorkGroupSize)
+		{
+			std::cout << "Work-group size " << groupWidth << "x" << groupHeight << " is above the kernel's limit of "
+				<< maxWorkGroupSize << " work items" << std::endl;
+			return false;
+		}
+	}
+
+	workGroupWidth = groupWidth;
+	workGroupHeight = groupHeight;
+	return true;
+}
+
+void OpenCLDevice::tuneWorkGroupSize()
+{
+	size_t preferredMultiple = 1;
+	size_t maxWorkGroupSize = 1;
+	clGetKernelWorkGroupInfo(kernel, deviceID, CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE, sizeof(size_t), &preferredMultiple, NULL);
+	clGetKernelWorkGroupInfo(kernel, deviceID, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &maxWorkGroupSize, NULL);
+	if (preferredMultiple == 0)
+		preferredMultiple = 1;
+
+	std::cout << "OpenCL tuning work-group size on " << getName() << " (preferred multiple " << preferredMultiple
+		<< ", max " << maxWorkGroupSize << " work items)" << std::endl;
+
+	//Candidates are the driver's choice plus every power of two shape whose size is 1, 2, 4 or 8 times the
+	// preferred multiple, anything else would leave part of a wavefront/warp idle
+	std::vector<std::pair<int, int>> candidates;
+	candidates.push_back(std::make_pair(0, 0));
+	for (size_t groupSize = preferredMultiple; groupSize <= maxWorkGroupSize && groupSize <= preferredMultiple * 8; groupSize *= 2)
+	{
+		for (size_t groupWidth = 1; groupWidth <= groupSize; groupWidth *= 2)
+		{
+			if (groupSize % groupWidth == 0 && groupWidth <= 64 && groupSize / groupWidth <= 64)
+				candidates.push_back(std::make_pair((int)groupWidth, (int)(groupSize / groupWidth)));
+		}
+	}
+
+	//Every candidate renders into the first output buffer
+	unmapHeldPixels(0);
+
+	const int repeats = 3;
+	uint64_t bestTime = std::numeric_limits<uint64_t>::max();
+	std::pair<int, int> best(0, 0);
+
+	for (auto& candidate : candidates)
+	{
+		workGroupWidth = candidate.first;
+		workGroupHeight = candidate.second;
+
+		//First run is a warm up, then keep the fastest of the rest so one slow run doesn't discard a shape
+		uint64_t candidateTime = std::numeric_limits<uint64_t>::max();
+		for (int repeatIndex = 0; repeatIndex <= repeats; repeatIndex++)
+		{
+			cl_event kernelEvent = NULL;
+			if (enqueueKernel(0, 0, frameHeight, &kernelEvent) != CL_SUCCESS)
+			{
+				candidateTime = std::numeric_limits<uint64_t>::max();
+				break;
+			}
+
+			uint64_t kernelTime = getEventDuration(kernelEvent);
+			if (repeatIndex > 0)
+				candidateTime = std::min(candidateTime, kernelTime);
+		}
+
+		if (candidateTime == std::numeric_limits<uint64_t>::max())
+		{
+			std::cout << " - " << candidate.first << "x" << candidate.second << ": failed" << std::endl;
+			continue;
+		}
+
+		std::cout << " - " << candidate.first << "x" << candidate.second << ": " << (candidateTime / 1000) << " microseconds" << std::endl;
+
+		if (candidateTime < bestTime)
+		{
+			bestTime = candidateTime;
+			best = candidate;
+		}
+	}
+
+	clFinish(cmdQueue);
+
+	workGroupWidth = best.first;
+	workGroupHeight = best.second;
+
+	std::cout << "OpenCL work-group size tuned to " << workGroupWidth << "x" << workGroupHeight << std::endl;
+}
+
+cl_int OpenCLDevice::enqueueKernel(int bufferIndex, int firstRow, int rowCount, cl_event* event)
+{
+	//Arguments are captured when the kernel is enqueued, so switching buffers doesn't affect a kernel in flight
+	clSetKernelArg(kernel, 0, sizeof(cl_mem), (void*)&outputBuffers[bufferIndex]);
+
+	//One work item per pixel in 2D so a work-group covers a tile of neighbouring (coherent) rays,
+	// the range is rounded up to whole work-groups and the kernel skips the items past the edge.
+	// A band starts at its first row through the global offset, which get_global_id() already includes
+	size_t localWorkSize[2] = { (size_t)workGroupWidth, (size_t)workGroupHeight };
+	size_t globalWorkOffset[2] = { 0, (size_t)firstRow };
+	size_t globalWorkSize[2] = { (size_t)frameWidth, (size_t)rowCount };
+
+	bool driverChoosesGroups = (workGroupWidth == 0 || workGroupHeight == 0);
+	if (!driverChoosesGroups)
+	{
+		globalWorkSize[0] = ((globalWorkSize[0] + localWorkSize[0] - 1) / localWorkSize[0]) * localWorkSize[0];
+		globalWorkSize[1] = ((globalWorkSize[1] + localWorkSize[1] - 1) / localWorkSize[1]) * localWorkSize[1];
+	}
+
+	return clEnqueueNDRangeKernel(
+		cmdQueue,
+		kernel,
+		2,
+		globalWorkOffset,
+		globalWorkSize,
+		driverChoosesGroups ? NULL : localWorkSize,
+		0,
+		NULL,
+		event
+	);
+}
+
+void OpenCLDevice::beginBand(int bufferIndex, int firstRow, int rowCount)
+{
+	Band& band = bands[bufferIndex];
+	band.firstRow = firstRow;
+	band.rowCount = rowCount;
+	band.kernelEvent = NULL;
+	band.mapEvent = NULL;
+	band.pixels = nullptr;
+	band.readyTime = 0;
+
+	//The writes run before the kernel, so they are timed with this band
+	band.writeEvents.insert(band.writeEvents.end(), pendingWriteEvents.begin(), pendingWriteEvents.end());
+	pendingWriteEvents.clear();
+
+	if (rowCount <= 0)
+		return;
+
+	//The kernel would write over rows still mapped for the host
+	unmapHeldPixels(bufferIndex);
+
+	cl_int errorCode = enqueueKernel(bufferIndex, firstRow, rowCount, &band.kernelEvent);
+	if (errorCode != CL_SUCCESS)
+	{
+		std::cout << "OpenCL could not enqueue a execute kernel command, errorcode: " << getErrorString(errorCode) << std::endl;
+	}
+
+	//Non-blocking so the other devices can be started before this one is waited on,
+	// rows past the band may have been written by the rounded up range but only the band is read back
+	size_t rowBytes = (sizeof(unsigned char) * 4) * frameWidth;
+	band.pixels = (unsigned char*)clEnqueueMapBuffer(
+		cmdQueue,
+		outputBuffers[bufferIndex],
+		CL_FALSE,
+		CL_MAP_READ,
+		rowBytes * firstRow,
+		rowBytes * rowCount,
+		0,
+		NULL,
+		&band.mapEvent,
+		&errorCode);
+	if (errorCode != CL_SUCCESS)
+	{
+		std::cout << "OpenCL could not enqueue a execute map buffer command, errorcode: " << getErrorString(errorCode) << std::endl;
+		band.pixels = nullptr;
+	}
+	else
+	{
+		//finishBand() falls back to when it was waited on if the runtime can't call back
+		clSetEventCallback(band.mapEvent, CL_COMPLETE, onBandReady, &band);
+	}
+
+	clFlush(cmdQueue);
+}
+
+void CL_CALLBACK OpenCLDevice::onBandReady(cl_event, cl_int, void* band)
+{
+	setBandReadyTime(*(Band*)band);
+}
+
+void OpenCLDevice::setBandReadyTime(Band& band)
+{
+	//Whichever of the callback and finishBand() gets here first sets it
+	uint64_t notSet = 0;
+	band.readyTime.compare_exchange_strong(notSet, PerformanceCounter::getTimestampNanoseconds());
+}
+
+bool OpenCLDevice::isBandReady(int bufferIndex)
+{
+	const Band& band = bands[bufferIndex];
+	if (band.rowCount <= 0 || band.mapEvent == NULL)
+		return true;
+
+	cl_int status = CL_COMPLETE;
+	if (clGetEventInfo(band.mapEvent, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(cl_int), &status, NULL) != CL_SUCCESS)
+		return true;
+
+	//Negative statuses are errors, finishBand() reports them rather than waiting forever
+	return status <= CL_COMPLETE;
+}
+
+uint64_t OpenCLDevice::finishBand(int bufferIndex, unsigned char* pixels)
+{
+	Band& band = bands[bufferIndex];
+	band.profile = OpenCLProfile();
+
+	if (band.rowCount <= 0)
+	{
+		collectWriteEvents(band.writeEvents, band.profile);
+		return 0;
+	}
+
+	cl_int errorCode = CL_SUCCESS;
+	if (band.mapEvent != NULL)
+		errorCode = clWaitForEvents(1, &band.mapEvent);
+	setBandReadyTime(band);
+
+	//Everything enqueued before the map has run now, including the writes and the buffer's last unmap
+	collectWriteEvents(band.writeEvents, band.profile);
+	band.profile.unmap = getEventDuration(band.unmapEvent);
+	band.unmapEvent = NULL;
+
+	uint64_t kernelTime = getEventDuration(band.kernelEvent);
+	band.profile.kernel = kernelTime;
+	band.profile.map = getEventDuration(band.mapEvent);
+
+	if (band.pixels != nullptr)
+	{
+		//Already packed RGBA8 so this is a straight copy, mapping a buffer that wraps the host frame
+		// points into the host frame so when that is the pixel array the rows are already in place
+		size_t rowBytes = (sizeof(unsigned char) * 4) * frameWidth;
+		unsigned char* bandPixels = pixels + (rowBytes * band.firstRow);
+		if (errorCode == CL_SUCCESS && band.pixels != bandPixels)
+			memcpy(bandPixels, band.pixels, rowBytes * band.rowCount);
+
+		//The host only has defined access to rows while they are mapped, so rows rendered in place stay
+		// mapped while they are presented and are unmapped when the buffer is next rendered into
+		band.heldPixels = band.pixels;
+		if (errorCode != CL_SUCCESS || band.pixels != bandPixels)
+			unmapHeldPixels(bufferIndex);
+	}
+
+	band.kernelEvent = NULL;
+	band.mapEvent = NULL;
+	band.pixels = nullptr;
+	band.rowCount = 0;
+
+	return kernelTime;
+}
+
+void OpenCLDevice::unmapHeldPixels(int bufferIndex)
+{
+	Band& band = bands[bufferIndex];
+	if (band.heldPixels == nullptr)
+		return;
+
+	//Clear raw pixel ptr, without waiting as the unmap is timed with the buffer's next band
+	cl_int errorCode = clEnqueueUnmapMemObject(
+		cmdQueue,
+		outputBuffers[bufferIndex],
+		band.heldPixels,
+		0,
+		NULL,
+		&band.unmapEvent
+	);
+	if (errorCode != CL_SUCCESS)
+	{
+		std::cout << "OpenCL could not enqueue a execute um-map buffer command, errorcode: " << getErrorString(errorCode) << std::endl;
+		band.unmapEvent = NULL;
+	}
+
+	clFlush(cmdQueue);
+	band.heldPixels = nullptr;
+}
+
+void OpenCLDevice::finish()
+{
+	clFinish(cmdQueue);
+}
+
+void OpenCLDevice::collectWriteEvents(std::vector<cl_event>& writeEvents, OpenCLProfile& profile)
+{
+	for (cl_event writeEvent : writeEvents)
+	{
+		profile.write += getEventDuration(writeEvent);
+		profile.writeCount++;
+	}
+
+	writeEvents.clear();
+}
+
+uint64_t OpenCLDevice::getEventDuration(cl_event event)
+{
+	if (event == NULL)
+		return 0;
+
+	cl_ulong start = 0;
+	cl_ulong end = 0;
+
+	cl_int errorCode = clWaitForEvents(1, &event);
+	if (errorCode == CL_SUCCESS)
+		errorCode = clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &start, NULL);
+	if (errorCode == CL_SUCCESS)
+		errorCode = clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &end, NULL);
+
+	clReleaseEvent(event);
+
+	if (errorCode != CL_SUCCESS)
+	{
+		std::cout << "OpenCL could not get event profiling info, errorcode: " << getErrorString(errorCode) << std::endl;
+		return 0;
+	}
+
+	return (end > start) ? (end - start) : 0;
+}
+
+cl_mem OpenCLDevice::createBuffer(cl_mem_flags flags, size_t size, const void* data, std::string name)
+{
+	cl_int errorCode;
+
+	//A buffer using host memory is created around the data rather than filled from it
+	bool useHostPtr = (flags & CL_MEM_USE_HOST_PTR) != 0;
+
+	//OpenCL doesn't allow empty buffers, so an empty scene list still gets a small one
+	cl_mem buffer = clCreateBuffer(
+		context,
+		flags,
+		(size > 0) ? size : sizeof(glm::vec4),
+		useHostPtr ? (void*)data : NULL, &errorCode
+	);
+	if (buffer == NULL)
+	{
+		std::cout << "OpenCL could not create the " << name << " buffer, errorcode: " << getErrorString(errorCode) << std::endl;
+		return NULL;
+	}
+
+	MemoryCounter::addSubsystemBytes(MemoryCounter::DeviceBuffers, getBufferSize(buffer));
+
+	if (data != nullptr && size > 0 && !useHostPtr)
+	{
+		//Non-blocking, the in-order queue runs it before any kernel enqueued after it
+		cl_event writeEvent = NULL;
+		errorCode = clEnqueueWriteBuffer(
+			cmdQueue,
+			buffer,
+			CL_FALSE,
+			0,
+			size,
+			data,
+			0,
+			NULL,
+			&writeEvent
+		);
+		if (errorCode != CL_SUCCESS)
+		{
+			std::cout << "OpenCL could not write to the " << name << " buffer, errorcode: " << getErrorString(errorCode) << std::endl;
+		}
+		else
+		{
+			pendingWriteEvents.push_back(writeEvent);
+		}
+	}
+
+	return buffer;
+}
+
+void OpenCLDevice::createFrameBuffers(int width, int height, const glm::vec4& rayDir)
+{
+	releaseFrameBuffers();
+
+	std::cout << "OpenCL creating frame buffers for " << (width * height) << " pixels on " << getName()
+		<< (zeroCopy ? " in host memory" : "") << std::endl;
+
+	//Each covers the whole frame so the device can be given any band without recreating them,
+	// the output buffer kernel argument is set per band
+	size_t frameBytes = (sizeof(unsigned char) * 4) * width * height;
+	for (int bufferIndex = 0; bufferIndex < BUFFER_COUNT; bufferIndex++)
+	{
+		if (zeroCopy)
+		{
+			//The kernel writes straight into the host frame, if that fails the device falls back to its own buffer
+			size_t hostFrameSize = getHostFrameSize(frameBytes);
+			hostFrames[bufferIndex] = allocateHostFrame(hostFrameSize);
+			if (hostFrames[bufferIndex] != nullptr)
+			{
+				outputBuffers[bufferIndex] = createBuffer(CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY | CL_MEM_USE_HOST_PTR,
+					hostFrameSize, hostFrames[bufferIndex], "output");
+
+				if (outputBuffers[bufferIndex] != NULL)
+				{
+					MemoryCounter::addSubsystemBytes(MemoryCounter::FrameBuffer, frameBytes);
+					continue;
+				}
+
+				freeHostFrame(hostFrames[bufferIndex]);
+			}
+		}
+
+		outputBuffers[bufferIndex] = createBuffer(CL_MEM_WRITE_ONLY | CL_MEM_HOST_READ_ONLY, frameBytes, nullptr, "output");
+	}
+
+	//The kernel works out each ray origin from its pixel index, see RayTracer::getRayOrigin()
+	clSetKernelArg(kernel, 8, sizeof(int), (void*)&width);
+	clSetKernelArg(kernel, 13, sizeof(int), (void*)&height);
+	clSetKernelArg(kernel, 9, sizeof(glm::vec4), (void*)&rayDir);
+
+	frameWidth = width;
+	frameHeight = height;
+}
+
+void OpenCLDevice::uploadScene(const SceneView& scene)
+{
+	releaseSceneBuffers();
+
+	std::cout << "OpenCL uploading scene to " << getName() << std::endl;
+
+	//The scene is already held in flat arrays laid out the way the kernel reads them
+	int numCubes = scene.cubeCount;
+	int numSpheres = scene.sphereCount;
+	int numNodes = scene.nodeCount;
+
+	sphereOriginsBuffer = createBuffer(CL_MEM_READ_ONLY, sizeof(glm::vec4) * scene.sphereCount, scene.sphereOrigins, "sphere origins");
+	sphereRadiusBuffer = createBuffer(CL_MEM_READ_ONLY, sizeof(float) * scene.sphereCount, scene.sphereRadius, "sphere radius");
+	sphereColoursBuffer = createBuffer(CL_MEM_READ_ONLY, sizeof(glm::vec4) * scene.sphereCount, scene.sphereColours, "sphere colours");
+	trianglesBuffer = createBuffer(CL_MEM_READ_ONLY, scene.triangles->getDataSize(), scene.triangles->getData(), "triangles");
+	cubeColoursBuffer = createBuffer(CL_MEM_READ_ONLY, sizeof(glm::vec4) * scene.cubeCount, scene.cubeColours, "cube colours");
+	bvhNodesBuffer = createBuffer(CL_MEM_READ_ONLY, sizeof(BVHNode) * scene.nodeCount, scene.nodes, "BVH nodes");
+	bvhPrimitiveIndicesBuffer = createBuffer(CL_MEM_READ_ONLY, sizeof(int) * scene.primitiveIndexCount, scene.primitiveIndices, "BVH primitive indices");
+
+	//Kernel args persist on the kernel, so only need setting when the buffers change
+	clSetKernelArg(kernel, 1, sizeof(int), (void*)&numSpheres);
+	clSetKernelArg(kernel, 2, sizeof(sphereOriginsBuffer), (void*)&sphereOriginsBuffer);
+	clSetKernelArg(kernel, 3, sizeof(sphereRadiusBuffer), (void*)&sphereRadiusBuffer);
+	clSetKernelArg(kernel, 4, sizeof(sphereColoursBuffer), (void*)&sphereColoursBuffer);
+	clSetKernelArg(kernel, 5, sizeof(int), (void*)&numCubes);
+	clSetKernelArg(kernel, 6, sizeof(trianglesBuffer), (void*)&trianglesBuffer);
+	clSetKernelArg(kernel, 7, sizeof(cubeColoursBuffer), (void*)&cubeColoursBuffer);
+	clSetKernelArg(kernel, 10, sizeof(int), (void*)&numNodes);
+	clSetKernelArg(kernel, 11, sizeof(bvhNodesBuffer), (void*)&bvhNodesBuffer);
+	clSetKernelArg(kernel, 12, sizeof(bvhPrimitiveIndicesBuffer), (void*)&bvhPrimitiveIndicesBuffer);
+
+	sceneUploaded = true;
+}
+
+void OpenCLDevice::releaseBuffer(cl_mem& buffer)
+{
+	if (buffer != NULL)
+	{
+		MemoryCounter::addSubsystemBytes(MemoryCounter::DeviceBuffers, -getBufferSize(buffer));
+
+		clReleaseMemObject(buffer);
+		buffer = NULL;
+	}
+}
+
+long long OpenCLDevice::getBufferSize(cl_mem buffer)
+{
+	//The device allocates nothing for a buffer using host memory, the host memory is counted by its owner
+	cl_mem_flags flags = 0;
+	if (clGetMemObjectInfo(buffer, CL_MEM_FLAGS, sizeof(cl_mem_flags), &flags, NULL) == CL_SUCCESS && (flags & CL_MEM_USE_HOST_PTR))
+		return 0;
+
+	size_t size = 0;
+	if (clGetMemObjectInfo(buffer, CL_MEM_SIZE, sizeof(size_t), &size, NULL) != CL_SUCCESS)
+		return 0;
+
+	return (long long)size;
+}
+
+void OpenCLDevice::releaseFrameBuffers()
+{
+	//The host frames can't be freed while mapped, or while anything enqueued on their buffers may still touch them
+	for (int bufferIndex = 0; bufferIndex < BUFFER_COUNT; bufferIndex++)
+	{
+		unmapHeldPixels(bufferIndex);
+	}
+
+	if (cmdQueue != NULL && zeroCopy)
+		clFinish(cmdQueue);
+
+	for (int bufferIndex = 0; bufferIndex < BUFFER_COUNT; bufferIndex++)
+	{
+		releaseBuffer(outputBuffers[bufferIndex]);
+
+		if (hostFrames[bufferIndex] != nullptr)
+		{
+			MemoryCounter::addSubsystemBytes(MemoryCounter::FrameBuffer, -(long long)((sizeof(unsigned char) * 4) * frameWidth * frameHeight));
+			freeHostFrame(hostFrames[bufferIndex]);
+		}
+	}
+
+	frameWidth = 0;
+	frameHeight = 0;
+}
+
+size_t OpenCLDevice::getHostFrameSize(size_t frameBytes)
+{
+	const size_t cacheLineSize = 64;
+	return ((frameBytes + cacheLineSize - 1) / cacheLineSize) * cacheLineSize;
+}
+
+unsigned char* OpenCLDevice::allocateHostFrame(size_t size)
+{
+	return (unsigned char*)AlignedAllocator<unsigned char, HOST_FRAME_ALIGNMENT>::allocateBytes(size);
+}
+
+void OpenCLDevice::freeHostFrame(unsigned char*& hostFrame)
+{
+	AlignedAllocator<unsigned char, HOST_FRAME_ALIGNMENT>::freeBytes(hostFrame);
+	hostFrame = nullptr;
+}
+
+void OpenCLDevice::releaseSceneBuffers()
+{
+	releaseBuffer(sphereOriginsBuffer);
+	releaseBuffer(sphereRadiusBuffer);
+	releaseBuffer(sphereColoursBuffer);
+	releaseBuffer(trianglesBuffer);
+	releaseBuffer(cubeColoursBuffer);
+	releaseBuffer(bvhNodesBuffer);
+	releaseBuffer(bvhPrimitiveIndicesBuffer);
+
+	sceneUploaded = false;
+}
+
+bool OpenCLDevice::buildProgram(std::string buildOptions)
+{
+	cl_int error = clBuildProgram(program, 1, &deviceID, buildOptions.c_str(), NULL, NULL);
+	if (error != CL_SUCCESS)
+	{
+		std::cout << "OpenCL could not build program, errorcode: " << error << std::endl;
+
+		char log[128000]; //128KB log, should be more than enough
+		if (clGetProgramBuildInfo(program, deviceID, CL_PROGRAM_BUILD_LOG, 128000, &log, NULL) != CL_SUCCESS)
+		{
+			std::cout << "OpenCL could not get build error log" << std::endl;
+		}
+		else
+		{
+			std::cout << "Build Log:" << std::endl << log << std::endl;
+		}
+		return false;
+	}
+
+	return true;
+}
+
+std::string OpenCLDevice::getProgramCachePath()
+{
+	//Kept with the settings as the install directory may not be writable
+	char* prefPath = SDL_GetPrefPath("RH", "GCP A2");
+	if (prefPath == nullptr)
+		return "";
+
+	std::string cacheDirectory = prefPath;
+	SDL_free(prefPath);
+
+	return cacheDirectory + getProgramCacheFileName(getPlatformName(), getName(), getDriverVersion());
+}
+
+std::string OpenCLDevice::getProgramCacheFileName(const std::string& platformName, const std::string& deviceName, const std::string& driverVersion)
+{
+	//One file per platform, device and driver so switching between them doesn't throw away the other builds
+	return "rayTracer." + Utility::hashString(platformName + "|" + deviceName + "|" + driverVersion) + ".bin";
+}
+
+std::string OpenCLDevice::getProgramCacheKey(const std::string& source, const std::string& buildOptions)
+{
+	return getProgramCacheKey(getPlatformName(), getName(), getDriverVersion(), source, buildOptions);
+}
+
+std::string OpenCLDevice::getProgramCacheKey(const std::string& platformName, const std::string& deviceName, const std::string& driverVersion,
+	const std::string& source, const std::string& buildOptions)
+{
+	//A new driver or any change to the kernel or its options gives a different key, so the old binary is ignored
+	return platformName + "|" + deviceName + "|" + driverVersion + "|" + Utility::hashString(source + "|" + buildOptions);
+}
+
+std::string OpenCLDevice::getPlatformName()
+{
+	cl_platform_id platformID = NULL;
+	if (clGetDeviceInfo(deviceID, CL_DEVICE_PLATFORM, sizeof(cl_platform_id), &platformID, NULL) != CL_SUCCESS)
+		return "";
+
+	char name[1000];
+	if (clGetPlatformInfo(platformID, CL_PLATFORM_NAME, sizeof(name), name, NULL) != CL_SUCCESS)
+		return "";
+
+	return name;
+}
+
+std::string OpenCLDevice::getDriverVersion()
+{
+	char driverVersion[1000];
+	if (clGetDeviceInfo(deviceID, CL_DRIVER_VERSION, sizeof(driverVersion), driverVersion, NULL) != CL_SUCCESS)
+		return "";
+
+	return driverVersion;
+}
+
+cl_program OpenCLDevice::loadProgramFromCache(const std::string& key, std::string buildOptions)
+{
+	std::string path = getProgramCachePath();
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+
+	if (!file.is_open())
+	{
+		std::cout << "OpenCL program cache not found, compiling from source" << std::endl;
+		return NULL;
+	}
+
+	//The key is on the first line, then the binary
+	std::string cachedKey;
+	std::getline(file, cachedKey);
+	if (cachedKey != key)
+	{
+		std::cout << "OpenCL program cache is out of date, compiling from source" << std::endl;
+		return NULL;
+	}
+
+	std::vector<unsigned char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (binary.empty())
+		return NULL;
+
+	const unsigned char* binaryData = binary.data();
+	size_t binarySize = binary.size();
+	cl_int binaryStatus = CL_SUCCESS;
+	cl_int error = CL_SUCCESS;
+
+	cl_program cachedProgram = clCreateProgramWithBinary(context, 1, &deviceID, &binarySize, &binaryData, &binaryStatus, &error);
+	if (cachedProgram == NULL || error != CL_SUCCESS || binaryStatus != CL_SUCCESS)
+	{
+		std::cout << "OpenCL rejected the cached program, errorcode: " << getErrorString(error != CL_SUCCESS ? error : binaryStatus) << std::endl;
+		if (cachedProgram != NULL)
+			clReleaseProgram(cachedProgram);
+		return NULL;
+	}
+
+	//Binaries still have to be built, but this only links them
+	error = clBuildProgram(cachedProgram, 1, &deviceID, buildOptions.c_str(), NULL, NULL);
+	if (error != CL_SUCCESS)
+	{
+		std::cout << "OpenCL could not build the cached program, errorcode: " << getErrorString(error) << std::endl;
+		clReleaseProgram(cachedProgram);
+		return NULL;
+	}
+
+	std::cout << "OpenCL program loaded from cache " << path << std::endl;
+	return cachedProgram;
+}
+
+void OpenCLDevice::saveProgramToCache(const std::string& key)
+{
+	size_t binarySize = 0;
+	if (clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binarySize, NULL) != CL_SUCCESS || binarySize == 0)
+	{
+		std::cout << "OpenCL program binary not available, it won't be cached" << std::endl;
+		return;
+	}
+
+	std::vector<unsigned char> binary(binarySize);
+	unsigned char* binaryData = binary.data();
+	if (clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(unsigned char*), &binaryData, NULL) != CL_SUCCESS)
+	{
+		std::cout << "OpenCL program binary could not be read, it won't be cached" << std::endl;
+		return;
+	}
+
+	std::string path = getProgramCachePath();
+	std::ofstream file(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "OpenCL program cache couldn't be written: " << path << std::endl;
+		return;
+	}
+
+	file << key << "\n";
+	file.write((const char*)binary.data(), binary.size());
+
+	std::cout << "OpenCL program cached to " << path << std::endl;
+}
+
+std::string OpenCLDevice::deviceTypeToString(cl_device_type type)
+{
+	std::string result;
+
+	if (type & CL_DEVICE_TYPE_CPU)
+		result += "CPU ";
+
+	if (type & CL_DEVICE_TYPE_GPU)
+		result += "GPU ";
+
+	if (type & CL_DEVICE_TYPE_ACCELERATOR)
+		result += "Accelerator ";
+
+	if (type & CL_DEVICE_TYPE_DEFAULT)
+		result += "Default ";
+
+	if (type & CL_DEVICE_TYPE_CUSTOM)
+		result += "Custom ";
+
+
+	if (result.empty())
+		result = "Unknown";
+
+	return result;
+}
+
+const char * OpenCLDevice::getErrorString(cl_int error)
+{
+	//Copied from stack overflow as I am not writing these out manually.
+	//Ref: http://stackoverflow.com/a/24336429/3262098
+	switch (error) 
+	{
+		// run-time and JIT compiler errors
+		case 0: return "CL_SUCCESS";
+		case -1: return "CL_DEVICE_NOT_FOUND";
+		case -2: return "CL_DEVICE_NOT_AVAILABLE";
+		case -3: return "CL_COMPILER_NOT_AVAILABLE";
+		case -4: return "CL_MEM_OBJECT_ALLOCATION_FAILURE";
+		case -5: return "CL_OUT_OF_RESOURCES";
+		case -6: return "CL_OUT_OF_HOST_MEMORY";
+		case -7: return "CL_PROFILING_INFO_NOT_AVAILABLE";
+		case -8: return "CL_MEM_COPY_OVERLAP";
+		case -9: return "CL_IMAGE_FORMAT_MISMATCH";
+		case -10: return "CL_IMAGE_FORMAT_NOT_SUPPORTED";
+		case -11: return "CL_BUILD_PROGRAM_FAILURE";
+		case -12: return "CL_MAP_FAILURE";
+		case -13: return "CL_MISALIGNED_SUB_BUFFER_OFFSET";
+		case -14: return "CL_EXEC_STATUS_ERROR_FOR_EVENTS_IN_WAIT_LIST";
+		case -15: return "CL_COMPILE_PROGRAM_FAILURE";
+		case -16: return "CL_LINKER_NOT_AVAILABLE";
+		case -17: return "CL_LINK_PROGRAM_FAILURE";
+		case -18: return "CL_DEVICE_PARTITION_FAILED";
+		case -19: return "CL_KERNEL_ARG_INFO_NOT_AVAILABLE";
+
+			// compile-time errors
+		case -30: return "CL_INVALID_VALUE";
+		case -31: return "CL_INVALID_DEVICE_TYPE";
+		case -32: return "CL_INVALID_PLATFORM";
+		case -33: return "CL_INVALID_DEVICE";
+		case -34: return "CL_INVALID_CONTEXT";
+		case -35: return "CL_INVALID_QUEUE_PROPERTIES";
+		case -36: return "CL_INVALID_COMMAND_QUEUE";
+		case -37: return "CL_INVALID_HOST_PTR";
+		case -38: return "CL_INVALID_MEM_OBJECT";
+		case -39: return "CL_INVALID_IMAGE_FORMAT_DESCRIPTOR";
+		case -40: return "CL_INVALID_IMAGE_SIZE";
+		case -41: return "CL_INVALID_SAMPLER";
+		case -42: return "CL_INVALID_BINARY";
+		case -43: return "CL_INVALID_BUILD_OPTIONS";
+		case -44: return "CL_INVALID_PROGRAM";
+		case -45: return "CL_INVALID_PROGRAM_EXECUTABLE";
+		case -46: return "CL_INVALID_KERNEL_NAME";
+		case -47: return "CL_INVALID_KERNEL_DEFINITION";
+		case -48: return "CL_INVALID_KERNEL";
+		case -49: return "CL_INVALID_ARG_INDEX";
+		case -50: return "CL_INVALID_ARG_VALUE";
+		case -51: return "CL_INVALID_ARG_SIZE";
+		case -52: return "CL_INVALID_KERNEL_ARGS";
+		case -53: return "CL_INVALID_WORK_DIMENSION";
+		case -54: return "CL_INVALID_WORK_GROUP_SIZE";
+		case -55: return "CL_INVALID_WORK_ITEM_SIZE";
+		case -56: return "CL_INVALID_GLOBAL_OFFSET";
+		case -57: return "CL_INVALID_EVENT_WAIT_LIST";
+		case -58: return "CL_INVALID_EVENT";
+		case -59: return "CL_INVALID_OPERATION";
+		case -60: return "CL_INVALID_GL_OBJECT";
+		case -61: return "CL_INVALID_BUFFER_SIZE";
+		case -62: return "CL_INVALID_MIP_LEVEL";
+		case -63: return "CL_INVALID_GLOBAL_WORK_SIZE";
+		case -64: return "CL_INVALID_PROPERTY";
+		case -65: return "CL_INVALID_IMAGE_DESCRIPTOR";
+		case -66: return "CL_INVALID_COMPILER_OPTIONS";
+		case -67: return "CL_INVALID_LINKER_OPTIONS";
+		case -68: return "CL_INVALID_DEVICE_PARTITION_COUNT";
+
+			// extension errors
+		case -1000: return "CL_INVALID_GL_SHAREGROUP_REFERENCE_KHR";
+		case -1001: return "CL_PLATFORM_NOT_FOUND_KHR";
+		case -1002: return "CL_INVALID_D3D10_DEVICE_KHR";
+		case -1003: return "CL_INVALID_D3D10_RESOURCE_KHR";
+		case -1004: return "CL_D3D10_RESOURCE_ALREADY_ACQUIRED_KHR";
+		case -1005: return "CL_D3D10_RESOURCE_NOT_ACQUIRED_KHR";
+		default: return "Unknown OpenCL error";
+	}
+}
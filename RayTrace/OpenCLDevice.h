@@ -0,0 +1,511 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <clew.h>
+
+#include "glm/glm.hpp"
+#include "SceneView.h"
+
+/** @brief	Device side timings of each stage of an OpenCL render, read from the command queue's profiling events. */
+struct OpenCLProfile
+{
+	/** @brief	Time spent writing buffers in nanoseconds, 0 when nothing had changed. */
+	uint64_t write;
+	/** @brief	Number of buffer writes. */
+	int writeCount;
+	/** @brief	Time the kernel ran for in nanoseconds. */
+	uint64_t kernel;
+	/** @brief	Time mapping the output buffer took in nanoseconds. */
+	uint64_t map;
+	/** @brief	Time unmapping the output buffer took in nanoseconds. */
+	uint64_t unmap;
+};
+
+/**
+@brief	One OpenCL device with its own context, command queue, built program and buffers.
+	The ray tracer kernel can be run over any band of rows so several devices can share a frame.
+	There are two output buffers, each with its own band, so the next frame can be started while
+	the last one is still being read back. On devices sharing memory with the host the output buffers
+	wrap page aligned host frames, so the kernel writes straight into memory the host can present.
+*/
+class OpenCLDevice
+{
+public:
+
+	/** @brief	Number of output buffers, and so the number of frames that can be in flight at once. */
+	static const int BUFFER_COUNT = 2;
+
+	/**
+	 @brief	Constructor, call init() before using the device.
+
+	 @param	deviceID	The OpenCL device.
+	 */
+	OpenCLDevice(cl_device_id deviceID);
+
+	/** @brief	Destructor, releases every OpenCL object the device created. */
+	~OpenCLDevice();
+
+	/**
+	 @brief	Creates the context and command queue and builds the ray tracer program,
+		reusing the cached binary if it was built from the same source, options and driver.
+
+	 @param	source			The kernel source.
+	 @param	buildOptions	The build options.
+
+	 @return	false if the device can't be used.
+	 */
+	bool init(const std::string& source, const std::string& buildOptions);
+
+	/**
+	 @brief	Gets the name of the device.
+
+	 @return	The device name.
+	 */
+	std::string getName();
+
+	/**
+	 @brief	Gets the OpenCL device.
+
+	 @return	The device.
+	 */
+	cl_device_id getDeviceID() { return deviceID; }
+
+	/**
+	 @brief	Sets the work-group shape the kernel is run with, 0x0 leaves the shape to the driver.
+
+	 @param	groupWidth 	Width of the work-group in pixels.
+	 @param	groupHeight	Height of the work-group in pixels.
+
+	 @return	false if the device can't run work-groups that big, the size is left unchanged.
+	 */
+	bool setWorkGroupSize(int groupWidth, int groupHeight);
+
+	/**
+	 @brief	Gets the width of the work-group.
+
+	 @return	The width in pixels, 0 if the driver chooses.
+	 */
+	int getWorkGroupWidth() { return workGroupWidth; }
+
+	/**
+	 @brief	Gets the height of the work-group.
+
+	 @return	The height in pixels, 0 if the driver chooses.
+	 */
+	int getWorkGroupHeight() { return workGroupHeight; }
+
+	/**
+	 @brief	Times the kernel over the whole frame with a range of work-group shapes built from the kernel's
+		preferred work-group size multiple, and keeps the fastest. The frame buffers and scene must be ready.
+	 */
+	void tuneWorkGroupSize();
+
+	/**
+	 @brief	Query if the frame buffers match a frame size.
+
+	 @param	width 	The width of the frame.
+	 @param	height	The height of the frame.
+
+	 @return	true if the frame buffers can be rendered into.
+	 */
+	bool hasFrameBuffers(int width, int height) { return frameWidth == width && frameHeight == height; }
+
+	/**
+	 @brief	Query if the output buffers wrap host frames, so reading them back needs no copy.
+
+	 @return	true if the device shares memory with the host.
+	 */
+	bool isZeroCopy() { return zeroCopy; }
+
+	/**
+	 @brief	Gets the host frame an output buffer wraps. Only complete once a band rendered into it has been finished,
+		and only readable until the next band is begun in the buffer as that unmaps it.
+
+	 @param	bufferIndex	The output buffer.
+
+	 @return	The pixels of the whole frame packed RGBA8, null if the device doesn't share memory with the host.
+	 */
+	unsigned char* getHostFrame(int bufferIndex) { return hostFrames[bufferIndex]; }
+
+	/**
+	 @brief	(Re)creates the output buffers for a frame size and sets the camera kernel arguments.
+
+	 @param	width  	The width of the frame.
+	 @param	height 	The height of the frame.
+	 @param	rayDir	The direction of every ray.
+	 */
+	void createFrameBuffers(int width, int height, const glm::vec4& rayDir);
+
+	/**
+	 @brief	Query if the scene buffers hold the current scene.
+
+	 @return	true if the scene is uploaded.
+	 */
+	bool isSceneUploaded() { return sceneUploaded; }
+
+	/** @brief	Marks the scene buffers out of date, they are re-uploaded before the next render. */
+	void markSceneOutOfDate() { sceneUploaded = false; }
+
+	/**
+	 @brief	Uploads a scene and its BVH, replacing the previous scene's buffers. The writes don't block so the
+		scene must not change until they have run, see finish().
+
+	 @param	scene	The scene.
+	 */
+	void uploadScene(const SceneView& scene);
+
+	/**
+	 @brief	Enqueues the ray tracer kernel over a band of rows with the current work-group size.
+
+	 @param 			bufferIndex	The output buffer to render into.
+	 @param 			firstRow	The first row of the band.
+	 @param 			rowCount	Number of rows in the band.
+	 @param [in,out]	event   	If non-null, the event for the kernel.
+
+	 @return	The OpenCL error code.
+	 */
+	cl_int enqueueKernel(int bufferIndex, int firstRow, int rowCount, cl_event* event);
+
+	/**
+	 @brief	Starts rendering a band of rows into an output buffer. The kernel and map are only enqueued and flushed,
+		call finishBand() to collect it, so several devices and frames can run at once.
+
+	 @param	bufferIndex	The output buffer to render into, must not have a band in flight.
+	 @param	firstRow   	The first row of the band.
+	 @param	rowCount   	Number of rows in the band.
+	 */
+	void beginBand(int bufferIndex, int firstRow, int rowCount);
+
+	/**
+	 @brief	Query if the band in an output buffer has been read back, without blocking.
+
+	 @param	bufferIndex	The output buffer.
+
+	 @return	true if finishBand() won't have to wait.
+	 */
+	bool isBandReady(int bufferIndex);
+
+	/**
+	 @brief	Waits for the band in an output buffer if it isn't ready, copies it into the pixel array
+		and releases the buffer for the next band. Nothing is copied if the pixel array is the buffer's host frame.
+
+	 @param 			bufferIndex	The output buffer.
+	 @param [in,out]	pixels	   	The pixel array of the whole frame, packed RGBA8.
+
+	 @return	The time the kernel took in nanoseconds, 0 if the band was empty or failed.
+	 */
+	uint64_t finishBand(int bufferIndex, unsigned char* pixels);
+
+	/**
+	 @brief	Gets the stage timings of the last band finished in an output buffer.
+
+	 @param	bufferIndex	The output buffer.
+
+	 @return	The profile.
+	 */
+	const OpenCLProfile& getBandProfile(int bufferIndex) { return bands[bufferIndex].profile; }
+
+	/**
+	 @brief	Gets when the last band finished in an output buffer was read back, from the host's clock.
+		Recorded by the runtime as the map completes, so it doesn't depend on when the band was polled.
+
+	 @param	bufferIndex	The output buffer.
+
+	 @return	The PerformanceCounter::getTimestampNanoseconds() time, 0 if the band was empty.
+	 */
+	uint64_t getBandReadyTime(int bufferIndex) { return bands[bufferIndex].readyTime; }
+
+	/** @brief	Blocks until everything enqueued on the device has run. */
+	void finish();
+
+	/**
+	 @brief	Reads how long a command took to run on the device and releases its event.
+		Waits for the command to complete first.
+
+	 @param	event	The event returned when the command was enqueued.
+
+	 @return	The time between the command starting and ending in nanoseconds, 0 if it isn't known.
+	 */
+	static uint64_t getEventDuration(cl_event event);
+
+	/**
+	 @brief	cl_device_type to string.
+
+	 @param	type	The type.
+
+	 @return	A std::string of the type.
+	 */
+	static std::string deviceTypeToString(cl_device_type type);
+
+	/**
+	 @brief	Gets OpenCL error string.
+
+	 @param	error	The error.
+
+	 @return	Null if it fails, else the error string.
+	 */
+	static const char* getErrorString(cl_int error);
+
+private:
+
+	/** @brief	Checks the program cache keys and file names change with what they are made from. */
+	friend class SelfTest;
+
+	/** @brief	The OpenCL device. */
+	cl_device_id deviceID;
+	/** @brief	The OpenCL context. */
+	cl_context context;
+	/** @brief	The OpenCL command queue. */
+	cl_command_queue cmdQueue;
+	/** @brief	The OpenCL program. */
+	cl_program program;
+	/** @brief	The OpenCL kernel. */
+	cl_kernel kernel;
+
+	//Buffers, kept on the device between renders
+	/** @brief	The output buffers, each covers the whole frame. */
+	cl_mem outputBuffers[BUFFER_COUNT];
+	/** @brief	The sphere origins buffer. */
+	cl_mem sphereOriginsBuffer;
+	/** @brief	The sphere radius buffer. */
+	cl_mem sphereRadiusBuffer;
+	/** @brief	The sphere colours buffer. */
+	cl_mem sphereColoursBuffer;
+	/** @brief	The cube triangles buffer, a copy of the triangle store's component arrays. */
+	cl_mem trianglesBuffer;
+	/** @brief	The cube colours buffer. */
+	cl_mem cubeColoursBuffer;
+	/** @brief	The BVH nodes buffer. */
+	cl_mem bvhNodesBuffer;
+	/** @brief	The BVH primitive indices buffer. */
+	cl_mem bvhPrimitiveIndicesBuffer;
+
+	/** @brief	Alignment of the host frames, a page so the runtime can use them without a copy. */
+	static const size_t HOST_FRAME_ALIGNMENT = 4096;
+
+	/** @brief	True if the output buffers wrap host frames. */
+	bool zeroCopy;
+	/** @brief	The host frame each output buffer wraps, null if the device doesn't share memory with the host. */
+	unsigned char* hostFrames[BUFFER_COUNT];
+
+	/** @brief	True if the scene buffers hold the current scene. */
+	bool sceneUploaded;
+	/** @brief	The width of the frame the output buffers were created for, 0 if not created. */
+	int frameWidth;
+	/** @brief	The height of the frame the output buffers were created for, 0 if not created. */
+	int frameHeight;
+
+	/** @brief	Width of the work-group, 0 if the driver chooses. */
+	int workGroupWidth;
+	/** @brief	Height of the work-group, 0 if the driver chooses. */
+	int workGroupHeight;
+
+	/** @brief	A band of rows rendered into one of the output buffers. */
+	struct Band
+	{
+		/** @brief	The first row of the band. */
+		int firstRow;
+		/** @brief	Number of rows in the band, 0 if the buffer is free. */
+		int rowCount;
+		/** @brief	The events of the buffer writes enqueued before the band. */
+		std::vector<cl_event> writeEvents;
+		/** @brief	The kernel event of the band. */
+		cl_event kernelEvent;
+		/** @brief	The map event of the band. */
+		cl_event mapEvent;
+		/** @brief	The unmap event of the buffer's previous band, read once the next band is finished. */
+		cl_event unmapEvent;
+		/** @brief	The mapped rows of the band, null if the map failed. */
+		unsigned char* pixels;
+		/** @brief	The rows of the last band left mapped as they were rendered in place into the host frame, null if unmapped. */
+		unsigned char* heldPixels;
+		/** @brief	The stage timings of the band. */
+		OpenCLProfile profile;
+		/** @brief	When the map completed on the host's clock, 0 until it has. Set from the runtime's callback thread. */
+		std::atomic<uint64_t> readyTime;
+	};
+
+	/** @brief	The band in each output buffer. */
+	Band bands[BUFFER_COUNT];
+
+	/** @brief	The events of buffer writes not yet followed by a band. */
+	std::vector<cl_event> pendingWriteEvents;
+
+	/**
+	 @brief	Records when a band's map completed, called by the runtime.
+
+	 @param	event 	The map event.
+	 @param	status	The event's status.
+	 @param	band  	The band.
+	 */
+	static void CL_CALLBACK onBandReady(cl_event event, cl_int status, void* band);
+
+	/**
+	 @brief	Sets a band's ready time to now if it hasn't been set.
+
+	 @param [in,out]	band	The band.
+	 */
+	static void setBandReadyTime(Band& band);
+
+	/**
+	 @brief	Unmaps the rows a finished band left mapped in an output buffer, if any, without waiting.
+
+	 @param	bufferIndex	The output buffer.
+	 */
+	void unmapHeldPixels(int bufferIndex);
+
+	/**
+	 @brief	Reads how long every write took and releases their events. The writes must have run.
+
+	 @param 			writeEvents	The write events, cleared.
+	 @param [in,out]	profile	   	The profile to add the write times to.
+	 */
+	void collectWriteEvents(std::vector<cl_event>& writeEvents, OpenCLProfile& profile);
+
+	/**
+	 @brief	Creates a buffer and optionally fills it. The write doesn't block, so the data must stay unchanged
+		until it has run.
+
+	 @param	flags	The memory flags.
+	 @param	size 	The size in bytes.
+	 @param	data 	The data to upload, nullptr to leave the buffer uninitialised. With CL_MEM_USE_HOST_PTR the host memory
+	 				the buffer uses instead, which must outlive it.
+	 @param	name 	The name of the buffer, used in error messages.
+
+	 @return	The buffer, NULL if it could not be created.
+	 */
+	cl_mem createBuffer(cl_mem_flags flags, size_t size, const void* data, std::string name);
+
+	/**
+	 @brief	Releases a buffer if it exists, and stops counting its memory.
+
+	 @param [in,out]	buffer	The buffer, set to NULL.
+	 */
+	void releaseBuffer(cl_mem& buffer);
+
+	/**
+	 @brief	Gets the size the device allocated for a buffer.
+
+	 @param	buffer	The buffer.
+
+	 @return	The size in bytes, 0 if it couldn't be queried.
+	 */
+	long long getBufferSize(cl_mem buffer);
+
+	/** @brief	Releases the output buffers and their host frames. */
+	void releaseFrameBuffers();
+
+	/**
+	 @brief	Gets the size of the host frame and the buffer wrapping it, rounded up to whole cache lines
+		as some runtimes only use host memory in place when its address is page aligned and its size is too.
+
+	 @param	frameBytes	The size of the frame's pixels in bytes.
+
+	 @return	The size in bytes.
+	 */
+	static size_t getHostFrameSize(size_t frameBytes);
+
+	/**
+	 @brief	Allocates a page aligned host frame.
+
+	 @param	size	The size in bytes, from getHostFrameSize().
+
+	 @return	The host frame, null if it could not be allocated.
+	 */
+	static unsigned char* allocateHostFrame(size_t size);
+
+	/**
+	 @brief	Frees a host frame.
+
+	 @param [in,out]	hostFrame	The host frame, may be null, set to null.
+	 */
+	static void freeHostFrame(unsigned char*& hostFrame);
+
+	/** @brief	Releases the scene buffers. */
+	void releaseSceneBuffers();
+
+	/**
+	 @brief	Builds the program for the device and logs the build log if it fails.
+
+	 @param	buildOptions	The build options.
+
+	 @return	false if the program failed to build.
+	 */
+	bool buildProgram(std::string buildOptions);
+
+	/**
+	 @brief	Gets the path of the file the device's compiled program is cached in, in the user's preferences directory.
+
+	 @return	The path, empty if there is no preferences directory.
+	 */
+	std::string getProgramCachePath();
+
+	/**
+	 @brief	Gets the name of the file a compiled program is cached in, one per platform, device and driver.
+
+	 @param	platformName 	The name of the platform.
+	 @param	deviceName   	The name of the device.
+	 @param	driverVersion	The version of the driver.
+
+	 @return	The file name.
+	 */
+	static std::string getProgramCacheFileName(const std::string& platformName, const std::string& deviceName, const std::string& driverVersion);
+
+	/**
+	 @brief	Gets the key the device's cached program has to match to be used.
+
+	 @param	source			The kernel source.
+	 @param	buildOptions	The build options.
+
+	 @return	The key.
+	 */
+	std::string getProgramCacheKey(const std::string& source, const std::string& buildOptions);
+
+	/**
+	 @brief	Gets the key a cached program has to match to be used, made from the platform and device names,
+		driver version and a hash of the source and build options.
+
+	 @param	platformName 	The name of the platform.
+	 @param	deviceName   	The name of the device.
+	 @param	driverVersion	The version of the driver.
+	 @param	source			The kernel source.
+	 @param	buildOptions	The build options.
+
+	 @return	The key.
+	 */
+	static std::string getProgramCacheKey(const std::string& platformName, const std::string& deviceName, const std::string& driverVersion,
+		const std::string& source, const std::string& buildOptions);
+
+	/**
+	 @brief	Gets the name of the platform the device is on.
+
+	 @return	The name, empty if it couldn't be queried.
+	 */
+	std::string getPlatformName();
+
+	/**
+	 @brief	Gets the version of the driver the device is run by.
+
+	 @return	The version, empty if it couldn't be queried.
+	 */
+	std::string getDriverVersion();
+
+	/**
+	 @brief	Creates and builds the program from the cached binary if the cache matches the key.
+
+	 @param	key				The cache key.
+	 @param	buildOptions	The build options.
+
+	 @return	The program, NULL if there is no usable cache.
+	 */
+	cl_program loadProgramFromCache(const std::string& key, std::string buildOptions);
+
+	/**
+	 @brief	Saves the binary of the built program to the cache.
+
+	 @param	key	The cache key.
+	 */
+	void saveProgramToCache(const std::string& key);
+};
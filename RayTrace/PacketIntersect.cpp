@@ -0,0 +1,298 @@
+#include "PacketIntersect.h"
+
+#include <algorithm>
+
+#include "misc/Log.h"
+#include "misc/Utility.h"
+#include "resources/shaders/Intersect.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PACKET_INTERSECT_X86
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+//MSVC lets any function use any intrinsic
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+#include <cpuid.h>
+//GCC and Clang only emit wider instructions in functions marked for them.
+//AVX-512 brings FMA with it, which GCC would fuse the multiplies and subtracts into, rounding differently to the other paths
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#if defined(__GNUC__) && !defined(__clang__)
+#define TARGET_AVX512 __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#else
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+#endif
+#endif
+
+//Same epsilon as the scalar intersection code
+#define EPSILON ((float)INTERSECT_EPSILON)
+
+namespace
+{
+	/**
+	 @brief	Gets a bit mask with a bit set for each ray in use.
+
+	 @param	packet	The packet.
+
+	 @return	The mask.
+	 */
+	unsigned int activeMask(const RayPacket& packet)
+	{
+		return (packet.size >= 32) ? 0xFFFFFFFFu : ((1u << packet.size) - 1u);
+	}
+
+	//Portable fallback, one ray at a time but still in single precision
+	unsigned int intersectScalar(const RayPacket& packet, const float* vert0, const float* edge1, const float* edge2, float* t)
+	{
+		unsigned int hits = 0;
+
+		for (int i = 0; i < packet.size; i++)
+		{
+			float origin[3] = { packet.originX[i], packet.originY[i], packet.originZ[i] };
+			float direction[3] = { packet.directionX[i], packet.directionY[i], packet.directionZ[i] };
+			float u = 0.0f, v = 0.0f;
+
+			if (Intersect::intersectTriangle(origin, direction, vert0, edge1, edge2, &t[i], &u, &v) == 1)
+				hits |= 1u << i;
+		}
+
+		return hits;
+	}
+
+#ifdef PACKET_INTERSECT_X86
+	//4 rays per triangle
+	unsigned int intersectSSE(const RayPacket& packet, const float* vert0, const float* edge1, const float* edge2, float* t)
+	{
+		__m128 dirX = _mm_load_ps(packet.directionX);
+		__m128 dirY = _mm_load_ps(packet.directionY);
+		__m128 dirZ = _mm_load_ps(packet.directionZ);
+
+		__m128 e1X = _mm_set1_ps(edge1[0]), e1Y = _mm_set1_ps(edge1[1]), e1Z = _mm_set1_ps(edge1[2]);
+		__m128 e2X = _mm_set1_ps(edge2[0]), e2Y = _mm_set1_ps(edge2[1]), e2Z = _mm_set1_ps(edge2[2]);
+
+		//pvec = dir x edge2
+		__m128 pX = _mm_sub_ps(_mm_mul_ps(dirY, e2Z), _mm_mul_ps(dirZ, e2Y));
+		__m128 pY = _mm_sub_ps(_mm_mul_ps(dirZ, e2X), _mm_mul_ps(dirX, e2Z));
+		__m128 pZ = _mm_sub_ps(_mm_mul_ps(dirX, e2Y), _mm_mul_ps(dirY, e2X));
+
+		__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1X, pX), _mm_mul_ps(e1Y, pY)), _mm_mul_ps(e1Z, pZ));
+		__m128 mask = _mm_or_ps(_mm_cmple_ps(det, _mm_set1_ps(-EPSILON)), _mm_cmpge_ps(det, _mm_set1_ps(EPSILON)));
+		__m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+		//tvec = orig - vert0
+		__m128 tX = _mm_sub_ps(_mm_load_ps(packet.originX), _mm_set1_ps(vert0[0]));
+		__m128 tY = _mm_sub_ps(_mm_load_ps(packet.originY), _mm_set1_ps(vert0[1]));
+		__m128 tZ = _mm_sub_ps(_mm_load_ps(packet.originZ), _mm_set1_ps(vert0[2]));
+
+		__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tX, pX), _mm_mul_ps(tY, pY)), _mm_mul_ps(tZ, pZ)), invDet);
+		mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(u, _mm_setzero_ps()), _mm_cmple_ps(u, _mm_set1_ps(1.0f))));
+
+		//qvec = tvec x edge1
+		__m128 qX = _mm_sub_ps(_mm_mul_ps(tY, e1Z), _mm_mul_ps(tZ, e1Y));
+		__m128 qY = _mm_sub_ps(_mm_mul_ps(tZ, e1X), _mm_mul_ps(tX, e1Z));
+		__m128 qZ = _mm_sub_ps(_mm_mul_ps(tX, e1Y), _mm_mul_ps(tY, e1X));
+
+		__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dirX, qX), _mm_mul_ps(dirY, qY)), _mm_mul_ps(dirZ, qZ)), invDet);
+		mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(v, _mm_setzero_ps()), _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f))));
+
+		__m128 distance = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2X, qX), _mm_mul_ps(e2Y, qY)), _mm_mul_ps(e2Z, qZ)), invDet);
+		_mm_storeu_ps(t, distance);
+
+		return (unsigned int)_mm_movemask_ps(mask) & activeMask(packet);
+	}
+
+	//8 rays per triangle
+	TARGET_AVX2 unsigned int intersectAVX2(const RayPacket& packet, const float* vert0, const float* edge1, const float* edge2, float* t)
+	{
+		__m256 dirX = _mm256_load_ps(packet.directionX);
+		__m256 dirY = _mm256_load_ps(packet.directionY);
+		__m256 dirZ = _mm256_load_ps(packet.directionZ);
+
+		__m256 e1X = _mm256_set1_ps(edge1[0]), e1Y = _mm256_set1_ps(edge1[1]), e1Z = _mm256_set1_ps(edge1[2]);
+		__m256 e2X = _mm256_set1_ps(edge2[0]), e2Y = _mm256_set1_ps(edge2[1]), e2Z = _mm256_set1_ps(edge2[2]);
+
+		//pvec = dir x edge2
+		__m256 pX = _mm256_sub_ps(_mm256_mul_ps(dirY, e2Z), _mm256_mul_ps(dirZ, e2Y));
+		__m256 pY = _mm256_sub_ps(_mm256_mul_ps(dirZ, e2X), _mm256_mul_ps(dirX, e2Z));
+		__m256 pZ = _mm256_sub_ps(_mm256_mul_ps(dirX, e2Y), _mm256_mul_ps(dirY, e2X));
+
+		__m256 det = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1X, pX), _mm256_mul_ps(e1Y, pY)), _mm256_mul_ps(e1Z, pZ));
+		__m256 mask = _mm256_or_ps(_mm256_cmp_ps(det, _mm256_set1_ps(-EPSILON), _CMP_LE_OQ), _mm256_cmp_ps(det, _mm256_set1_ps(EPSILON), _CMP_GE_OQ));
+		__m256 invDet = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+
+		//tvec = orig - vert0
+		__m256 tX = _mm256_sub_ps(_mm256_load_ps(packet.originX), _mm256_set1_ps(vert0[0]));
+		__m256 tY = _mm256_sub_ps(_mm256_load_ps(packet.originY), _mm256_set1_ps(vert0[1]));
+		__m256 tZ = _mm256_sub_ps(_mm256_load_ps(packet.originZ), _mm256_set1_ps(vert0[2]));
+
+		__m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(tX, pX), _mm256_mul_ps(tY, pY)), _mm256_mul_ps(tZ, pZ)), invDet);
+		mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(u, _mm256_setzero_ps(), _CMP_GE_OQ), _mm256_cmp_ps(u, _mm256_set1_ps(1.0f), _CMP_LE_OQ)));
+
+		//qvec = tvec x edge1
+		__m256 qX = _mm256_sub_ps(_mm256_mul_ps(tY, e1Z), _mm256_mul_ps(tZ, e1Y));
+		__m256 qY = _mm256_sub_ps(_mm256_mul_ps(tZ, e1X), _mm256_mul_ps(tX, e1Z));
+		__m256 qZ = _mm256_sub_ps(_mm256_mul_ps(tX, e1Y), _mm256_mul_ps(tY, e1X));
+
+		__m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dirX, qX), _mm256_mul_ps(dirY, qY)), _mm256_mul_ps(dirZ, qZ)), invDet);
+		mask = _mm256_and_ps(mask, _mm256_and_ps(_mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_GE_OQ), _mm256_cmp_ps(_mm256_add_ps(u, v), _mm256_set1_ps(1.0f), _CMP_LE_OQ)));
+
+		__m256 distance = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2X, qX), _mm256_mul_ps(e2Y, qY)), _mm256_mul_ps(e2Z, qZ)), invDet);
+		_mm256_storeu_ps(t, distance);
+
+		return (unsigned int)_mm256_movemask_ps(mask) & activeMask(packet);
+	}
+
+	//16 rays per triangle
+	TARGET_AVX512 unsigned int intersectAVX512(const RayPacket& packet, const float* vert0, const float* edge1, const float* edge2, float* t)
+	{
+		__m512 dirX = _mm512_load_ps(packet.directionX);
+		__m512 dirY = _mm512_load_ps(packet.directionY);
+		__m512 dirZ = _mm512_load_ps(packet.directionZ);
+
+		__m512 e1X = _mm512_set1_ps(edge1[0]), e1Y = _mm512_set1_ps(edge1[1]), e1Z = _mm512_set1_ps(edge1[2]);
+		__m512 e2X = _mm512_set1_ps(edge2[0]), e2Y = _mm512_set1_ps(edge2[1]), e2Z = _mm512_set1_ps(edge2[2]);
+
+		//pvec = dir x edge2
+		__m512 pX = _mm512_sub_ps(_mm512_mul_ps(dirY, e2Z), _mm512_mul_ps(dirZ, e2Y));
+		__m512 pY = _mm512_sub_ps(_mm512_mul_ps(dirZ, e2X), _mm512_mul_ps(dirX, e2Z));
+		__m512 pZ = _mm512_sub_ps(_mm512_mul_ps(dirX, e2Y), _mm512_mul_ps(dirY, e2X));
+
+		__m512 det = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(e1X, pX), _mm512_mul_ps(e1Y, pY)), _mm512_mul_ps(e1Z, pZ));
+		__mmask16 mask = _mm512_cmp_ps_mask(det, _mm512_set1_ps(-EPSILON), _CMP_LE_OQ) | _mm512_cmp_ps_mask(det, _mm512_set1_ps(EPSILON), _CMP_GE_OQ);
+		__m512 invDet = _mm512_div_ps(_mm512_set1_ps(1.0f), det);
+
+		//tvec = orig - vert0
+		__m512 tX = _mm512_sub_ps(_mm512_load_ps(packet.originX), _mm512_set1_ps(vert0[0]));
+		__m512 tY = _mm512_sub_ps(_mm512_load_ps(packet.originY), _mm512_set1_ps(vert0[1]));
+		__m512 tZ = _mm512_sub_ps(_mm512_load_ps(packet.originZ), _mm512_set1_ps(vert0[2]));
+
+		__m512 u = _mm512_mul_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(tX, pX), _mm512_mul_ps(tY, pY)), _mm512_mul_ps(tZ, pZ)), invDet);
+		mask &= _mm512_cmp_ps_mask(u, _mm512_setzero_ps(), _CMP_GE_OQ) & _mm512_cmp_ps_mask(u, _mm512_set1_ps(1.0f), _CMP_LE_OQ);
+
+		//qvec = tvec x edge1
+		__m512 qX = _mm512_sub_ps(_mm512_mul_ps(tY, e1Z), _mm512_mul_ps(tZ, e1Y));
+		__m512 qY = _mm512_sub_ps(_mm512_mul_ps(tZ, e1X), _mm512_mul_ps(tX, e1Z));
+		__m512 qZ = _mm512_sub_ps(_mm512_mul_ps(tX, e1Y), _mm512_mul_ps(tY, e1X));
+
+		__m512 v = _mm512_mul_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dirX, qX), _mm512_mul_ps(dirY, qY)), _mm512_mul_ps(dirZ, qZ)), invDet);
+		mask &= _mm512_cmp_ps_mask(v, _mm512_setzero_ps(), _CMP_GE_OQ) & _mm512_cmp_ps_mask(_mm512_add_ps(u, v), _mm512_set1_ps(1.0f), _CMP_LE_OQ);
+
+		__m512 distance = _mm512_mul_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(e2X, qX), _mm512_mul_ps(e2Y, qY)), _mm512_mul_ps(e2Z, qZ)), invDet);
+		_mm512_storeu_ps(t, distance);
+
+		return (unsigned int)mask & activeMask(packet);
+	}
+
+	/**
+	 @brief	Runs the cpuid instruction.
+
+	 @param [in,out]	info   	eax, ebx, ecx and edx.
+	 @param 			leaf   	The leaf.
+	 @param 			subLeaf	The sub leaf.
+	 */
+	void cpuid(unsigned int info[4], unsigned int leaf, unsigned int subLeaf)
+	{
+#ifdef _MSC_VER
+		__cpuidex((int*)info, (int)leaf, (int)subLeaf);
+#else
+		__cpuid_count(leaf, subLeaf, info[0], info[1], info[2], info[3]);
+#endif
+	}
+
+	/**
+	 @brief	Reads which register states the OS saves on a context switch.
+
+	 @return	The XCR0 register.
+	 */
+	unsigned long long readXCR0()
+	{
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		unsigned int eax, edx;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return ((unsigned long long)edx << 32) | eax;
+#endif
+	}
+#endif // PACKET_INTERSECT_X86
+}
+
+PacketIntersect::IntersectFunction PacketIntersect::intersectFunction = intersectScalar;
+int PacketIntersect::packetSize = 4;
+std::string PacketIntersect::instructionSetName = "Scalar";
+std::vector<std::string> PacketIntersect::supportedInstructionSets(1, "Scalar");
+
+void PacketIntersect::init()
+{
+	supportedInstructionSets.assign(1, "Scalar");
+
+#ifdef PACKET_INTERSECT_X86
+	unsigned int info[4];
+	cpuid(info, 0, 0);
+	unsigned int maxLeaf = info[0];
+
+	cpuid(info, 1, 0);
+	bool sse2 = (info[3] & (1u << 26)) != 0;
+	bool osxsave = (info[2] & (1u << 27)) != 0;
+	bool avx = (info[2] & (1u << 28)) != 0;
+
+	bool avx2 = false;
+	bool avx512 = false;
+
+	//The CPU supporting the instructions isn't enough, the OS has to save the wider registers too
+	if (osxsave && avx && maxLeaf >= 7)
+	{
+		unsigned long long xcr0 = readXCR0();
+
+		cpuid(info, 7, 0);
+		avx2 = (info[1] & (1u << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+		avx512 = (info[1] & (1u << 16)) != 0 && (xcr0 & 0xE6) == 0xE6;
+	}
+
+	if (sse2)
+		supportedInstructionSets.push_back("SSE");
+	if (avx2)
+		supportedInstructionSets.push_back("AVX2");
+	if (avx512)
+		supportedInstructionSets.push_back("AVX-512");
+#endif
+
+	//Use the widest
+	setInstructionSet(supportedInstructionSets.back());
+
+	Log::logI("Packet Intersection using " + instructionSetName + " (" + Utility::intToString(packetSize) + " rays per packet)");
+}
+
+bool PacketIntersect::setInstructionSet(std::string name)
+{
+	if (std::find(supportedInstructionSets.begin(), supportedInstructionSets.end(), name) == supportedInstructionSets.end())
+		return false;
+
+	intersectFunction = intersectScalar;
+	packetSize = 4;
+
+#ifdef PACKET_INTERSECT_X86
+	if (name == "AVX-512")
+	{
+		intersectFunction = intersectAVX512;
+		packetSize = 16;
+	}
+	else if (name == "AVX2")
+	{
+		intersectFunction = intersectAVX2;
+		packetSize = 8;
+	}
+	else if (name == "SSE")
+	{
+		intersectFunction = intersectSSE;
+		packetSize = 4;
+	}
+#endif
+
+	instructionSetName = name;
+	return true;
+}
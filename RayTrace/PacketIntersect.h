@@ -0,0 +1,101 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/** @brief	A packet of rays stored as structure of arrays so they can be loaded straight into SIMD registers. */
+struct RayPacket
+{
+	/** @brief	The most rays a packet can hold (one AVX-512 register of floats). */
+	static const int MAX_SIZE = 16;
+
+	/** @brief	The ray origins. */
+	alignas(64) float originX[MAX_SIZE];
+	alignas(64) float originY[MAX_SIZE];
+	alignas(64) float originZ[MAX_SIZE];
+
+	/** @brief	The ray directions. */
+	alignas(64) float directionX[MAX_SIZE];
+	alignas(64) float directionY[MAX_SIZE];
+	alignas(64) float directionZ[MAX_SIZE];
+
+	/** @brief	Number of rays in use, unused lanes must still hold valid (e.g. duplicated) rays. */
+	int size;
+};
+
+/**
+@brief	Single precision Moller-Trumbore ray/triangle intersection for a packet of rays at once.
+	The widest instruction set the CPU supports (SSE, AVX2 or AVX-512) is picked at runtime by init().
+*/
+class PacketIntersect
+{
+public:
+
+	/** @brief	Detects the CPU's features and picks the matching implementation. */
+	static void init();
+
+	/**
+	 @brief	Gets the instruction sets init() found the CPU and OS support, narrowest first.
+
+	 @return	The instruction set names, always including "Scalar".
+	 */
+	static const std::vector<std::string>& getSupportedInstructionSets() { return supportedInstructionSets; }
+
+	/**
+	 @brief	Switches to a supported instruction set, so each one can be checked against the others.
+		Must not be called while packets are being intersected.
+
+	 @param	name	The instruction set name, from getSupportedInstructionSets().
+
+	 @return	false if the instruction set isn't supported.
+	 */
+	static bool setInstructionSet(std::string name);
+
+	/**
+	 @brief	Gets the number of rays the chosen implementation tests in one go.
+		Packets given to intersectTriangle should be this size for the best throughput.
+
+	 @return	The packet size (4, 8 or 16).
+	 */
+	static int getPacketSize() { return packetSize; }
+
+	/**
+	 @brief	Gets the name of the chosen instruction set.
+
+	 @return	The instruction set name.
+	 */
+	static std::string getInstructionSetName() { return instructionSetName; }
+
+	/**
+	 @brief	Intersects every ray in the packet with a triangle.
+
+	 @param 			packet	The rays, packet.size must not exceed getPacketSize().
+	 @param 			vert0 	Triangle Point 1.
+	 @param 			edge1 	The edge from point 1 to point 2.
+	 @param 			edge2 	The edge from point 1 to point 3.
+	 @param [in,out]	t	  	The hit distance of each ray, only valid where the ray hit.
+
+	 @return	A bit mask with bit i set if ray i hit the triangle.
+	 */
+	static unsigned int intersectTriangle(const RayPacket& packet, const float vert0[3], const float edge1[3], const float edge2[3], float* t)
+	{
+		return intersectFunction(packet, vert0, edge1, edge2, t);
+	}
+
+private:
+
+	/** @brief	Signature shared by every implementation. */
+	typedef unsigned int(*IntersectFunction)(const RayPacket&, const float*, const float*, const float*, float*);
+
+	/** @brief	The chosen implementation, defaults to the portable one until init() is called. */
+	static IntersectFunction intersectFunction;
+
+	/** @brief	The packet size of the chosen implementation. */
+	static int packetSize;
+
+	/** @brief	The name of the chosen instruction set. */
+	static std::string instructionSetName;
+
+	/** @brief	The instruction sets found by init(), narrowest first. */
+	static std::vector<std::string> supportedInstructionSets;
+};
@@ -306,7 +306,14 @@ void Platform::loadSettingsFromFile()
 	}
 
 	settings["MSAA"] = msaaSamples;
-	
+
+
+	//OpenCL Device (optional, older settings files don't have it)
+	openCLDevice = settingsFile.child("openCLDevice").child_value();
+	Log::logI("OpenCL Device from Settings File: " + (openCLDevice.empty() ? std::string("auto") : openCLDevice));
+
+	openCLFission = settingsFile.child("openCLFission").child_value();
+	Log::logI("OpenCL Fission from Settings File: " + (openCLFission.empty() ? std::string("none") : openCLFission));
 }
 
 void Platform::initSettingsFile()
@@ -367,6 +374,56 @@ int Platform::getSetting(std::string setting)
 }
 
 
+bool Platform::getWorkGroupSize(std::string deviceName, int& width, int& height)
+{
+	pugi::xml_document settingsFile;
+	if (!settingsFile.load_file(settingsFilePath.c_str()))
+		return false;
+
+	pugi::xml_node workGroup = settingsFile.find_child_by_attribute("openCLWorkGroup", "device", deviceName.c_str());
+	if (!workGroup)
+		return false;
+
+	width = atoi(workGroup.attribute("width").value());
+	height = atoi(workGroup.attribute("height").value());
+
+	Log::logI("OpenCL work-group size for " + deviceName + " from Settings File: "
+		+ Utility::intToString(width) + "x" + Utility::intToString(height));
+	return true;
+}
+
+bool Platform::saveWorkGroupSize(std::string deviceName, int width, int height)
+{
+	//Keep the comments so the file stays readable when it is written back out
+	pugi::xml_document settingsFile;
+	if (!settingsFile.load_file(settingsFilePath.c_str(), pugi::parse_default | pugi::parse_comments))
+	{
+		Log::logE("Settings File could not be parsed, work-group size not saved");
+		return false;
+	}
+
+	pugi::xml_node workGroup = settingsFile.find_child_by_attribute("openCLWorkGroup", "device", deviceName.c_str());
+	if (!workGroup)
+	{
+		workGroup = settingsFile.append_child("openCLWorkGroup");
+		workGroup.append_attribute("device") = deviceName.c_str();
+		workGroup.append_attribute("width");
+		workGroup.append_attribute("height");
+	}
+
+	workGroup.attribute("width") = width;
+	workGroup.attribute("height") = height;
+
+	if (!settingsFile.save_file(settingsFilePath.c_str(), "\t", pugi::format_default | pugi::format_no_declaration))
+	{
+		Log::logE("Could not write work-group size to Settings File");
+		return false;
+	}
+
+	Log::logI("Saved OpenCL work-group size for " + deviceName + " to Settings File");
+	return true;
+}
+
 bool Platform::isFeatureSupported(std::string feature)
 {
 	if (features.count(feature) == 0)
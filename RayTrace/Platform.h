@@ -97,6 +97,42 @@ public:
 
 	int getSetting(std::string setting);
 
+	/**
+	 @brief Gets the OpenCL device chosen in the settings file.
+	
+	 @return std::string - The device selection (see RayTracer's constructor), empty for the default.
+	 */
+	std::string getOpenCLDevice() { return openCLDevice; }
+
+	/**
+	 @brief Gets how the settings file says to split a CPU OpenCL device into sub-devices.
+	
+	 @return std::string - The fission (see RayTracer's constructor), empty for none.
+	 */
+	std::string getOpenCLFission() { return openCLFission; }
+
+	/**
+	 @brief Gets the OpenCL work-group size saved in the settings file for a device.
+	
+	 @param deviceName The OpenCL device name.
+	 @param [in,out] width The work-group width.
+	 @param [in,out] height The work-group height.
+	
+	 @return bool - false if nothing has been saved for the device.
+	 */
+	bool getWorkGroupSize(std::string deviceName, int& width, int& height);
+
+	/**
+	 @brief Saves an OpenCL work-group size for a device into the settings file, replacing any saved before.
+	
+	 @param deviceName The OpenCL device name.
+	 @param width The work-group width.
+	 @param height The work-group height.
+	
+	 @return bool - Was successful.
+	 */
+	bool saveWorkGroupSize(std::string deviceName, int width, int height);
+
 	bool isFeatureSupported(std::string feature);
 	
 private:
@@ -131,6 +167,12 @@ private:
 	
 	std::unordered_map<std::string, int> settings;
 
+	/** @brief The OpenCL device selection. */
+	std::string openCLDevice;
+
+	/** @brief The OpenCL device fission. */
+	std::string openCLFission;
+
 	//Platform Feature Support (Wraps SDL CPU feature detection)
 	std::unordered_map<std::string, bool> features;
 
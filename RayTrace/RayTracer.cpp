@@ -0,0 +1,1734 @@
+#include "RayTracer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+
+#include "lodepng.h"
+#include "misc/Utility.h"
+#include "misc/Random.h"
+#include "resources/shaders/Intersect.h"
+
+RayTracer::RayTracer(int width, int height, std::string openCLDevice, std::string openCLFission)
+	: width(width), height(height), timeTaken(0), openCLDeviceSelection(openCLDevice), openCLFission(openCLFission)
+{
+	pixelCount = width * height;
+	framePixels = nullptr;
+	cpuPrecision = Single;
+	logTimings = true;
+	sceneView = SceneView();
+
+	glm::mat4 proj = glm::perspective(45.0f, 4.0f / 3.0f, 0.0f, 100.0f);
+
+	rayDir = proj * glm::vec4(0, 0, 1, 1);
+
+	openCLProfile = OpenCLProfile();
+	openCLMultiDeviceInitialised = false;
+	hybridOpenCLShare = 0.5f;
+	hybridFrameInProgress = false;
+	hybridOpenCLRows = 0;
+	tileFirstRow = 0;
+	tileEndRow = 0;
+	tilesX = 0;
+	nextOpenCLFrame = 0;
+	openCLFramesInFlight = 0;
+	openCLSelectedDeviceID = NULL;
+	openCLSelectedDeviceCount = 0;
+
+	countedSceneBytes = 0;
+	countedFrameBufferBytes = 0;
+	updateMemoryCounters();
+
+	openCLAvailable = openCLInit();
+
+	threadPool = new ThreadPool();
+}
+
+RayTracer::~RayTracer()
+{
+	finishOpenCLFrames();
+
+	for (OpenCLDevice* device : openCLDevices)
+	{
+		delete device;
+	}
+
+	for (cl_device_id subDeviceID : openCLSubDeviceIDs)
+	{
+		clReleaseDevice(subDeviceID);
+	}
+
+	delete threadPool;
+
+	MemoryCounter::addSubsystemBytes(MemoryCounter::Scene, -countedSceneBytes);
+	MemoryCounter::addSubsystemBytes(MemoryCounter::FrameBuffer, -countedFrameBufferBytes);
+}
+
+bool RayTracer::setScene(int sceneNumber)
+{
+	bool validScene = true;
+
+	clearScene();
+
+	switch (sceneNumber)
+	{
+	case 1:
+		createScene1();
+		break;
+	case 2:
+		createScene2();
+		break;
+	case 3:
+		createScene3();
+		break;
+	default:
+		std::cout << "Invalid Scene Requested" << std::endl;
+		validScene = false;
+	}
+
+	buildScene();
+
+	return validScene;
+}
+
+void RayTracer::setSyntheticScene(int objectCount)
+{
+	clearScene();
+
+	//Spread over the whole image so larger resolutions still get a full frame of work
+	createRandomScene(objectCount, objectCount, (float)width, (float)height);
+
+	buildScene();
+}
+
+void RayTracer::clearScene()
+{
+	//The devices read the scene in the background, so let them finish before it changes
+	finishOpenCLFrames();
+	for (OpenCLDevice* device : openCLDevices)
+	{
+		device->finish();
+	}
+
+	sphereOrigins.clear();
+	sphereRadius.clear();
+	sphereColours.clear();
+	cubes.clear();
+	cubeColours.clear();
+}
+
+void RayTracer::buildScene()
+{
+	sceneTriangles.build(cubes);
+	sceneBVH.build(sceneTriangles, sphereOrigins, sphereRadius);
+
+	cubeColours.clear();
+	for (auto& cube : cubes)
+	{
+		cubeColours.push_back(cube.getColour());
+	}
+
+	//Everything the ray tracers read as flat arrays, so tracing a pixel never copies the scene
+	sceneView.nodes = sceneBVH.getNodes().data();
+	sceneView.nodeCount = (int)sceneBVH.getNodes().size();
+	sceneView.primitiveIndices = sceneBVH.getPrimitiveIndices().data();
+	sceneView.primitiveIndexCount = (int)sceneBVH.getPrimitiveIndices().size();
+	sceneView.triangles = &sceneTriangles;
+	sceneView.triangleCount = sceneTriangles.getCount();
+	sceneView.cubeColours = cubeColours.data();
+	sceneView.cubeCount = (int)cubeColours.size();
+	sceneView.sphereOrigins = sphereOrigins.data();
+	sceneView.sphereRadius = sphereRadius.data();
+	sceneView.sphereColours = sphereColours.data();
+	sceneView.sphereCount = (int)sphereOrigins.size();
+
+	//The device copies are now out of date, they are re-uploaded next time OpenCL renders
+	for (OpenCLDevice* device : openCLDevices)
+	{
+		device->markSceneOutOfDate();
+	}
+
+	updateMemoryCounters();
+}
+
+void RayTracer::updateMemoryCounters()
+{
+	//Capacity rather than size as that is what is actually allocated
+	long long sceneBytes = sphereOrigins.capacity() * sizeof(glm::vec4)
+		+ sphereRadius.capacity() * sizeof(float)
+		+ sphereColours.capacity() * sizeof(glm::vec4)
+		+ cubes.capacity() * sizeof(Cube)
+		+ cubes.size() * numOfTrianglesPerCube * numOfPointsInTriangle * sizeof(glm::vec4)
+		+ sceneTriangles.getMemoryUsage()
+		+ cubeColours.capacity() * sizeof(glm::vec4)
+		+ sceneBVH.getMemoryUsage();
+
+	long long frameBufferBytes = pixels.capacity() * sizeof(unsigned char);
+
+	MemoryCounter::addSubsystemBytes(MemoryCounter::Scene, sceneBytes - countedSceneBytes);
+	MemoryCounter::addSubsystemBytes(MemoryCounter::FrameBuffer, frameBufferBytes - countedFrameBufferBytes);
+
+	countedSceneBytes = sceneBytes;
+	countedFrameBufferBytes = frameBufferBytes;
+}
+
+void RayTracer::render(Mode mode)
+{
+	//Prepare pixel array, the ray tracers write straight into it
+	//Dimensions * 4 Bytes (RGBA8)
+	pixels.resize(pixelCount * 4);
+	framePixels = pixels.data();
+	updateMemoryCounters();
+
+	openCLProfile = OpenCLProfile();
+
+	switch (mode)
+	{
+	case CPU:
+		executeRayTracerCPU();
+		break;
+	case CPUParallel:
+		executeRayTracerCPUParallel();
+		break;
+	case OpenCL:
+		executeRayTracerOpenCL(openCLSelectedDeviceCount);
+		break;
+	case OpenCLMultiDevice:
+		if (openCLAvailable && !openCLMultiDeviceInitialised)
+			initOpenCLMultiDevice();
+
+		executeRayTracerOpenCL(openCLDevices.size());
+		break;
+	case Hybrid:
+		executeRayTracerHybrid();
+		break;
+	}
+}
+
+bool RayTracer::beginRenderAsync(Mode mode)
+{
+	if (!openCLAvailable || !isOpenCLMode(mode))
+		return false;
+
+	//The tuning has the first device's kernel until it is polled as finished
+	if (openCLFramesInFlight >= OpenCLDevice::BUFFER_COUNT || hybridFrameInProgress || workGroupTuning.valid())
+		return false;
+
+	//The CPU writes its rows straight into the pixel array, which the frames before it may still be copied into
+	if (mode == Hybrid && openCLFramesInFlight > 0)
+		return false;
+
+	pixels.resize(pixelCount * 4);
+	updateMemoryCounters();
+
+	if (mode == Hybrid)
+	{
+		framePixels = pixels.data();
+
+		std::cout << "Hybrid Ray Tracer Begin (async, " << threadPool->getThreadCount() << " threads, "
+			<< openCLSelectedDeviceCount << " OpenCL device" << (openCLSelectedDeviceCount > 1 ? "s" : "") << ")" << std::endl;
+
+		beginHybridFrame();
+		return true;
+	}
+
+	if (mode == OpenCLMultiDevice && !openCLMultiDeviceInitialised)
+		initOpenCLMultiDevice();
+
+	size_t deviceCount = (mode == OpenCLMultiDevice) ? openCLDevices.size() : openCLSelectedDeviceCount;
+	std::cout << getModeName(mode) << " Ray Tracer Begin (async, " << (openCLFramesInFlight + 1) << " frames in flight)" << std::endl;
+
+	beginOpenCLFrame(deviceCount, height, getModeName(mode));
+	return true;
+}
+
+bool RayTracer::pollRenderAsync()
+{
+	if (openCLFramesInFlight == 0 || !isOpenCLFrameReady())
+		return false;
+
+	if (hybridFrameInProgress && !threadPool->isBatchFinished())
+		return false;
+
+	OpenCLFrame& frame = openCLFrames[getOldestOpenCLFrame()];
+	std::string modeName = frame.modeName;
+
+	//From the frame being started to it being noticed as done, so it depends on how often this is polled
+	timeTaken = frame.timer.stopCounter();
+
+	if (hybridFrameInProgress)
+		finishHybridFrame();
+	else
+		finishOpenCLFrame();
+
+	logTimeTaken(modeName);
+
+	return true;
+}
+
+std::string RayTracer::getModeName(Mode mode)
+{
+	switch (mode)
+	{
+	case CPU:
+		return "CPU";
+	case CPUParallel:
+		return "CPU Parallel";
+	case OpenCL:
+		return "OpenCL";
+	case OpenCLMultiDevice:
+		return "OpenCL Multi Device";
+	case Hybrid:
+		return "Hybrid";
+	default:
+		return "Unknown";
+	}
+}
+
+std::string RayTracer::getModeArgument(Mode mode)
+{
+	switch (mode)
+	{
+	case CPU:
+		return "cpu";
+	case CPUParallel:
+		return "cpu-parallel";
+	case OpenCL:
+		return "opencl";
+	case OpenCLMultiDevice:
+		return "opencl-multi";
+	case Hybrid:
+		return "hybrid";
+	default:
+		return "unknown";
+	}
+}
+
+bool RayTracer::parseModeArgument(std::string argument, Mode& mode)
+{
+	if (argument == "cpu")
+		mode = CPU;
+	else if (argument == "cpu-parallel")
+		mode = CPUParallel;
+	else if (argument == "opencl")
+		mode = OpenCL;
+	else if (argument == "opencl-multi")
+		mode = OpenCLMultiDevice;
+	else if (argument == "hybrid")
+		mode = Hybrid;
+	else
+		return false;
+
+	return true;
+}
+
+bool RayTracer::parsePrecisionArgument(std::string argument, Precision& precision)
+{
+	if (argument == "float")
+		precision = Single;
+	else if (argument == "double")
+		precision = Double;
+	else
+		return false;
+
+	return true;
+}
+
+//Walks the BVH and converts params to be suitable for the intersect code
+template <typename T>
+glm::vec4 RayTracer::collide(const Ray& inRay, const SceneView& scene)
+{
+	T rayOrigin[3]{ inRay.origin.x, inRay.origin.y, inRay.origin.z };
+	T rayDirection[3]{ inRay.direction.x, inRay.direction.y, inRay.direction.z };
+
+	T tri0[3];
+	T edge1[3];
+	T edge2[3];
+
+	T t = 0;
+	T u = 0;
+	T v = 0;
+
+	float closest = 300000.0f; //Set to high number so it will always be beaten
+	int closestPrimitive = -1;
+
+	if (scene.nodeCount == 0)
+		return shadeHit(scene, closest, closestPrimitive);
+
+	const BVHNode* nodes = scene.nodes;
+	const int* primitiveIndices = scene.primitiveIndices;
+	const int triangleCount = scene.triangleCount;
+
+	//Nodes still to visit and the distance the ray enters them at
+	int stack[BVH::MAX_DEPTH];
+	float stackEntry[BVH::MAX_DEPTH];
+	int stackSize = 0;
+
+	float entry = 0.0f;
+	if (BVH::intersectBounds(nodes[0], inRay, closest, entry))
+	{
+		stack[stackSize] = 0;
+		stackEntry[stackSize] = entry;
+		stackSize++;
+	}
+
+	while (stackSize > 0)
+	{
+		stackSize--;
+
+		//A closer hit may have been found since this node was pushed
+		if (stackEntry[stackSize] > closest)
+			continue;
+
+		const BVHNode& node = nodes[stack[stackSize]];
+
+		if (node.primitiveCount == 0)
+		{
+			float leftEntry = 0.0f;
+			float rightEntry = 0.0f;
+			bool hitLeft = BVH::intersectBounds(nodes[node.leftOrFirst], inRay, closest, leftEntry);
+			bool hitRight = BVH::intersectBounds(nodes[node.leftOrFirst + 1], inRay, closest, rightEntry);
+			Intersect::pushChildren(stack, stackEntry, &stackSize, node.leftOrFirst, hitLeft, leftEntry, hitRight, rightEntry);
+
+			continue;
+		}
+
+		for (int i = 0; i < node.primitiveCount; i++)
+		{
+			int primitive = primitiveIndices[node.leftOrFirst + i];
+			float distance = 0.0f;
+
+			if (primitive < triangleCount)
+			{
+				//Set Triangles into array format for intersect test
+				scene.triangles->getTriangle(primitive, tri0, edge1, edge2);
+
+				if (Intersect::intersectTriangle(rayOrigin, rayDirection, tri0, edge1, edge2, &t, &u, &v) != 1)
+					continue;
+
+				distance = (float)t;
+			}
+			else
+			{
+				int sphereIndex = primitive - triangleCount;
+				const glm::vec4& sphereOrigin = scene.sphereOrigins[sphereIndex];
+				T sphereCentre[3]{ sphereOrigin.x, sphereOrigin.y, sphereOrigin.z };
+				distance = (float)Intersect::intersectSphere(rayOrigin, rayDirection, (T)scene.sphereRadius[sphereIndex], sphereCentre);
+
+				if (distance == 0.0f)
+					continue;
+			}
+
+			if (Intersect::isCloserHit(distance, primitive, closest, closestPrimitive))
+			{
+				closest = distance;
+				closestPrimitive = primitive;
+			}
+		}
+	}
+
+	return shadeHit(scene, closest, closestPrimitive);
+}
+
+//Both precisions are built here, the self test checks the packet path against the float one
+template glm::vec4 RayTracer::collide<float>(const Ray& inRay, const SceneView& scene);
+template glm::vec4 RayTracer::collide<double>(const Ray& inRay, const SceneView& scene);
+
+void RayTracer::collidePacket(const RayPacket& packet, const SceneView& scene, glm::vec4* colours)
+{
+	Ray rays[RayPacket::MAX_SIZE];
+	float closest[RayPacket::MAX_SIZE];
+	int closestPrimitive[RayPacket::MAX_SIZE];
+	alignas(64) float t[RayPacket::MAX_SIZE];
+
+	for (int lane = 0; lane < packet.size; lane++)
+	{
+		rays[lane].origin = glm::vec4(packet.originX[lane], packet.originY[lane], packet.originZ[lane], 1.0f);
+		rays[lane].direction = glm::vec4(packet.directionX[lane], packet.directionY[lane], packet.directionZ[lane], 0.0f);
+		closest[lane] = 300000.0f; //Set to high number so it will always be beaten
+		closestPrimitive[lane] = -1;
+	}
+
+	if (scene.nodeCount > 0)
+	{
+		const BVHNode* nodes = scene.nodes;
+		const int* primitiveIndices = scene.primitiveIndices;
+		const int triangleCount = scene.triangleCount;
+
+		//A node is visited if any ray in the packet passes through it,
+		// its entry distance is the nearest of those rays
+		auto packetHitsNode = [&](int nodeIndex, float& entryDistance)
+		{
+			bool hit = false;
+			entryDistance = std::numeric_limits<float>::max();
+
+			for (int lane = 0; lane < packet.size; lane++)
+			{
+				float laneEntry = 0.0f;
+				if (BVH::intersectBounds(nodes[nodeIndex], rays[lane], closest[lane], laneEntry))
+				{
+					entryDistance = std::min(entryDistance, laneEntry);
+					hit = true;
+				}
+			}
+
+			return hit;
+		};
+
+		int stack[BVH::MAX_DEPTH];
+		float stackEntry[BVH::MAX_DEPTH];
+		int stackSize = 0;
+
+		float entry = 0.0f;
+		if (packetHitsNode(0, entry))
+		{
+			stack[stackSize] = 0;
+			stackEntry[stackSize] = entry;
+			stackSize++;
+		}
+
+		while (stackSize > 0)
+		{
+			stackSize--;
+
+			//Skip the node if every ray has found something closer since it was pushed
+			float furthestClosest = *std::max_element(closest, closest + packet.size);
+			if (stackEntry[stackSize] > furthestClosest)
+				continue;
+
+			const BVHNode& node = nodes[stack[stackSize]];
+
+			if (node.primitiveCount == 0)
+			{
+				float leftEntry = 0.0f;
+				float rightEntry = 0.0f;
+				bool hitLeft = packetHitsNode(node.leftOrFirst, leftEntry);
+				bool hitRight = packetHitsNode(node.leftOrFirst + 1, rightEntry);
+				Intersect::pushChildren(stack, stackEntry, &stackSize, node.leftOrFirst, hitLeft, leftEntry, hitRight, rightEntry);
+
+				continue;
+			}
+
+			for (int i = 0; i < node.primitiveCount; i++)
+			{
+				int primitive = primitiveIndices[node.leftOrFirst + i];
+
+				if (primitive < triangleCount)
+				{
+					float vertex0[3], edge1[3], edge2[3];
+					scene.triangles->getTriangle(primitive, vertex0, edge1, edge2);
+
+					unsigned int hits = PacketIntersect::intersectTriangle(packet, vertex0, edge1, edge2, t);
+
+					for (int lane = 0; hits != 0; lane++, hits >>= 1)
+					{
+						if ((hits & 1) == 0)
+							continue;
+
+						if (Intersect::isCloserHit(t[lane], primitive, closest[lane], closestPrimitive[lane]))
+						{
+							closest[lane] = t[lane];
+							closestPrimitive[lane] = primitive;
+						}
+					}
+				}
+				else
+				{
+					int sphereIndex = primitive - triangleCount;
+					const glm::vec4& sphereOrigin = scene.sphereOrigins[sphereIndex];
+					float sphereCentre[3]{ sphereOrigin.x, sphereOrigin.y, sphereOrigin.z };
+
+					for (int lane = 0; lane < packet.size; lane++)
+					{
+						float origin[3]{ packet.originX[lane], packet.originY[lane], packet.originZ[lane] };
+						float direction[3]{ packet.directionX[lane], packet.directionY[lane], packet.directionZ[lane] };
+						float distance = Intersect::intersectSphere(origin, direction, scene.sphereRadius[sphereIndex], sphereCentre);
+
+						if (distance == 0.0f)
+							continue;
+
+						if (Intersect::isCloserHit(distance, primitive, closest[lane], closestPrimitive[lane]))
+						{
+							closest[lane] = distance;
+							closestPrimitive[lane] = primitive;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	for (int lane = 0; lane < packet.size; lane++)
+	{
+		colours[lane] = shadeHit(scene, closest[lane], closestPrimitive[lane]);
+	}
+}
+
+glm::vec4 RayTracer::shadeHit(const SceneView& scene, float closest, int closestPrimitive)
+{
+	glm::vec4 closestColour = glm::vec4(0, 0, 0, 255.0f);
+
+	//Check any object was hit, if not return black colour as no intersects occurred
+	if (closestPrimitive == -1)
+	{
+		return closestColour;
+	}
+	else
+	{
+		if (closestPrimitive < scene.triangleCount)
+		{
+			closestColour = scene.cubeColours[closestPrimitive / numOfTrianglesPerCube];
+		}
+		else
+		{
+			closestColour = scene.sphereColours[closestPrimitive - scene.triangleCount];
+		}
+
+		float colourScalar = Intersect::shadeDistance(closest);
+		closestColour = colourScalar * closestColour;
+		closestColour.w = 255.0f; //Reset to full on alpha channel
+		return closestColour;
+	}
+}
+
+void RayTracer::traceRow(int y, int startX, int endX)
+{
+	if (cpuPrecision == Double)
+	{
+		Ray ray;
+		ray.direction = rayDir;
+
+		for (int x = startX; x < endX; x++)
+		{
+			ray.origin = getRayOrigin(x, y);
+			glm::vec4 colour = collide<double>(ray, sceneView);
+
+			int pixelIndex = (y * width) + x;
+
+			pixels[(pixelIndex * 4)    ] = (unsigned char)(int)colour.r;
+			pixels[(pixelIndex * 4) + 1] = (unsigned char)(int)colour.g;
+			pixels[(pixelIndex * 4) + 2] = (unsigned char)(int)colour.b;
+			pixels[(pixelIndex * 4) + 3] = (unsigned char)(int)colour.a;
+		}
+
+		return;
+	}
+
+	int packetSize = PacketIntersect::getPacketSize();
+
+	RayPacket packet;
+	glm::vec4 colours[RayPacket::MAX_SIZE];
+
+	for (int x = startX; x < endX; x += packetSize)
+	{
+		packet.size = std::min(packetSize, endX - x);
+
+		//Unused lanes repeat the last ray so the SIMD code never reads garbage
+		for (int lane = 0; lane < packetSize; lane++)
+		{
+			glm::vec4 origin = getRayOrigin(x + std::min(lane, packet.size - 1), y);
+
+			packet.originX[lane] = origin.x;
+			packet.originY[lane] = origin.y;
+			packet.originZ[lane] = origin.z;
+			packet.directionX[lane] = rayDir.x;
+			packet.directionY[lane] = rayDir.y;
+			packet.directionZ[lane] = rayDir.z;
+		}
+
+		collidePacket(packet, sceneView, colours);
+
+		for (int lane = 0; lane < packet.size; lane++)
+		{
+			int pixelIndex = (y * width) + x + lane;
+
+			pixels[(pixelIndex * 4)    ] = (unsigned char)(int)colours[lane].r;
+			pixels[(pixelIndex * 4) + 1] = (unsigned char)(int)colours[lane].g;
+			pixels[(pixelIndex * 4) + 2] = (unsigned char)(int)colours[lane].b;
+			pixels[(pixelIndex * 4) + 3] = (unsigned char)(int)colours[lane].a;
+		}
+	}
+}
+
+bool RayTracer::encodePNG(const char* filename, const unsigned char* imageData, unsigned width, unsigned height)
+{
+	//Encode the image
+	unsigned error = lodepng::encode(filename, imageData, width, height);
+
+	//if there's an error, display it
+	if (error) std::cout << "encoder error " << error << ": " << lodepng_error_text(error) << std::endl;
+
+	return error == 0;
+}
+
+void RayTracer::createScene1()
+{
+	//Very small scene quick to render. Clipping objects is intended to show depth.
+
+	//Spheres
+	sphereOrigins.push_back(glm::vec4(300.0f, 250.0f, -85.0f, 1));
+	sphereOrigins.push_back(glm::vec4(500.0f, 250.0f, -85.0f, 1));
+
+	sphereRadius.push_back(50);
+	sphereRadius.push_back(30);
+
+	sphereColours.push_back(glm::vec4(0.0f, 1.0f, 1.0f, 255.0f));
+	sphereColours.push_back(glm::vec4(1.0f, 0.0f, 1.0f, 255.0f));
+
+
+	//Cubes
+	Cube cube1(glm::vec4(1.0f, 1.0f, 0.0f, 255.0f));
+	cube1.scale(glm::vec3(40.0f));
+	cube1.rotate(glm::vec3(0.0f, 0.0f, Utility::convertAngleToRadian(30.0f)));
+	cube1.rotate(glm::vec3(0.0f, Utility::convertAngleToRadian(30.0f), 0.0f));
+	cube1.translate(glm::vec3(70.0f, 60.0f, -60.0f));
+	cubes.push_back(cube1);
+
+	Cube cube2(glm::vec4(0.0f, 1.0f, 1.0f, 255.0f));
+	cube2.scale(glm::vec3(30.0f));
+	cube2.rotate(glm::vec3(0.0f, 0.0f, Utility::convertAngleToRadian(80.0f)));
+	cube2.rotate(glm::vec3(0.0f, Utility::convertAngleToRadian(250.0f), 0.0f));
+	cube2.translate(glm::vec3(150.0f, 60.0f, -70.0f));
+	cubes.push_back(cube2);
+
+	Cube cube3(glm::vec4(0.0f, 0.0f, 1.0f, 255.0f));
+	cube3.scale(glm::vec3(10.0f));
+	cube3.rotate(glm::vec3(0.0f, 0.0f, Utility::convertAngleToRadian(160.0f)));
+	cube3.rotate(glm::vec3(Utility::convertAngleToRadian(210.0f), 0.0f, 0.0f));
+	cube3.translate(glm::vec3(150.0f, 400.0f, -40.0f));
+	cubes.push_back(cube3);
+
+	Cube cube4(glm::vec4(1.0f, 0.0f, 0.0f, 255.0f));
+	cube4.scale(glm::vec3(50.0f));
+	cube4.rotate(glm::vec3(0.0f, 0.0f, Utility::convertAngleToRadian(80.0f)));
+	cube4.rotate(glm::vec3(0.0f, Utility::convertAngleToRadian(250.0f), 0.0f));
+	cube4.translate(glm::vec3(450.0f, 200.0f, -80.0f));
+	cubes.push_back(cube4);
+}
+
+void RayTracer::createScene2()
+{
+	//Partially Random but manually placed, clipping is on purpose to show depth
+
+	//Spheres
+	sphereOrigins.push_back(glm::vec4(100.0f, 150.0f, -85.0f, 1));
+	sphereOrigins.push_back(glm::vec4(300.0f, 400.0f, -65.0f, 1));
+	sphereOrigins.push_back(glm::vec4(350.0f, 150.0f, -85.0f, 1));
+	sphereOrigins.push_back(glm::vec4(200.0f, 250.0f, -85.0f, 1));
+	sphereOrigins.push_back(glm::vec4(200.0f, 350.0f, -45.0f, 1));
+	sphereOrigins.push_back(glm::vec4(600.0f, 450.0f, -125.0f, 1));
+	sphereOrigins.push_back(glm::vec4(20.0f, 450.0f, -64.0f, 1));
+	sphereOrigins.push_back(glm::vec4(620.0f, 250.0f, -115.0f, 1));
+
+	sphereRadius.push_back(50);
+	sphereRadius.push_back(30);
+	sphereRadius.push_back(15);
+	sphereRadius.push_back(25);
+	sphereRadius.push_back(20);
+	sphereRadius.push_back(42);
+	sphereRadius.push_back(42);
+	sphereRadius.push_back(32);
+
+	for (unsigned int i = 0; i < sphereRadius.size(); i++)
+	{
+		sphereColours.push_back(glm::vec4(
+			Random::getFloat(0.05f, 1.0f),
+			Random::getFloat(0.05f, 1.0f),
+			Random::getFloat(0.05f, 1.0f),
+			255.0f
+		));
+	}
+
+
+
+	//Cubes
+	Cube cube1(glm::vec4(1.0f, 1.0f, 0.0f, 255.0f));
+	cube1.scale(glm::vec3(40.0f));
+	cube1.rotate(glm::vec3(0.0f, 0.0f, Utility::convertAngleToRadian(30.0f)));
+	cube1.rotate(glm::vec3(0.0f, Utility::convertAngleToRadian(30.0f), 0.0f));
+	cube1.translate(glm::vec3(70.0f, 60.0f, -60.0f));
+	cubes.push_back(cube1);
+
+	Cube cube2(glm::vec4(0.0f, 1.0f, 1.0f, 255.0f));
+	cube2.scale(glm::vec3(30.0f));
+	cube2.rotate(glm::vec3(0.0f, 0.0f, Utility::convertAngleToRadian(80.0f)));
+	cube2.rotate(glm::vec3(0.0f, Utility::convertAngleToRadian(250.0f), 0.0f));
+	cube2.translate(glm::vec3(150.0f, 60.0f, -70.0f));
+	cubes.push_back(cube2);
+
+	Cube cube3(glm::vec4(0.0f, 0.0f, 1.0f, 255.0f));
+	cube3.scale(glm::vec3(10.0f));
+	cube3.rotate(glm::vec3(0.0f, 0.0f, Utility::convertAngleToRadian(160.0f)));
+	cube3.rotate(glm::vec3(Utility::convertAngleToRadian(210.0f), 0.0f, 0.0f));
+	cube3.translate(glm::vec3(150.0f, 400.0f, -40.0f));
+	cubes.push_back(cube3);
+
+	Cube cube4(glm::vec4(1.0f, 0.0f, 0.0f, 255.0f));
+	cube4.scale(glm::vec3(50.0f));
+	cube4.rotate(glm::vec3(0.0f, 0.0f, Utility::convertAngleToRadian(80.0f)));
+	cube4.rotate(glm::vec3(0.0f, Utility::convertAngleToRadian(250.0f), 0.0f));
+	cube4.translate(glm::vec3(450.0f, 200.0f, -80.0f));
+	cubes.push_back(cube4);
+
+	Cube cube5(glm::vec4(
+		Random::getFloat(0.05f, 1.0f),
+		Random::getFloat(0.05f, 1.0f),
+		Random::getFloat(0.05f, 1.0f),
+		255.0f));
+	cube5.scale(glm::vec3(30.0f));
+	cube5.rotate(glm::vec3(Utility::convertAngleToRadian(170.0f), 0.0f, 0.0f));
+	cube5.rotate(glm::vec3(0.0f, Utility::convertAngleToRadian(150.0f), 0.0f));
+	cube5.translate(glm::vec3(450.0f, 400.0f, -60.0f));
+	cubes.push_back(cube5);
+
+	Cube cube6(glm::vec4(
+		Random::getFloat(0.05f, 1.0f),
+		Random::getFloat(0.05f, 1.0f),
+		Random::getFloat(0.05f, 1.0f), 
+		255.0f));
+	cube6.scale(glm::vec3(50.0f));
+	cube6.rotate(glm::vec3(0.0f, 0.0f, Utility::convertAngleToRadian(80.0f)));
+	cube6.rotate(glm::vec3(Utility::convertAngleToRadian(350.0f), 0.0f, 0.0f));
+	cube6.translate(glm::vec3(50.0f, 300.0f, -100.0f));
+	cubes.push_back(cube6);
+
+	Cube cube7(glm::vec4(
+		Random::getFloat(0.05f, 1.0f),
+		Random::getFloat(0.05f, 1.0f),
+		Random::getFloat(0.05f, 1.0f),
+		255.0f));
+	cube7.scale(glm::vec3(70.0f));
+	cube7.rotate(glm::vec3(Utility::convertAngleToRadian(160.0f), 0.0f, 0.0f));
+	cube7.rotate(glm::vec3(0.0f, Utility::convertAngleToRadian(250.0f), 0.0f));
+	cube7.translate(glm::vec3(530.0f, 300.0f, -100.0f));
+	cubes.push_back(cube7);
+
+	Cube cube8(glm::vec4(
+		Random::getFloat(0.05f, 1.0f),
+		Random::getFloat(0.05f, 1.0f),
+		Random::getFloat(0.05f, 1.0f),
+		255.0f));
+	cube8.scale(glm::vec3(25.0f));
+	cube8.rotate(glm::vec3(0.0f, 0.0f, Utility::convertAngleToRadian(190.0f)));
+	cube8.rotate(glm::vec3(0.0f, Utility::convertAngleToRadian(140.0f), 0.0f));
+	cube8.translate(glm::vec3(230.0f, 150.0f, -40.0f));
+	cubes.push_back(cube8);
+
+	Cube cube9(glm::vec4(
+		Random::getFloat(0.05f, 1.0f),
+		Random::getFloat(0.05f, 1.0f),
+		Random::getFloat(0.05f, 1.0f),
+		255.0f));
+	cube9.scale(glm::vec3(50.0f));
+	cube9.rotate(glm::vec3(0.0f, Utility::convertAngleToRadian(130.0f), 0.0f));
+	cube9.rotate(glm::vec3(Utility::convertAngleToRadian(150.0f), 0.0f, 9.9f));
+	cube9.rotate(glm::vec3(0.0f, 0.0f, Utility::convertAngleToRadian(50.0f)));
+	cube9.translate(glm::vec3(510.0f, 50.0f, -90.0f));
+	cubes.push_back(cube9);
+
+	Cube cube10(glm::vec4(
+		Random::getFloat(0.05f, 1.0f),
+		Random::getFloat(0.05f, 1.0f),
+		Random::getFloat(0.05f, 1.0f),
+		255.0f));
+	cube10.scale(glm::vec3(24.0f));
+	cube10.rotate(glm::vec3(0.0f, 0.0f, Utility::convertAngleToRadian(280.0f)));
+	cube10.rotate(glm::vec3(0.0f, Utility::convertAngleToRadian(20.0f), 0.0f));
+	cube10.translate(glm::vec3(350.0f, 340.0f, -40.0f));
+	cubes.push_back(cube10);
+}
+
+void RayTracer::createScene3()
+{
+	//Auto Generated (Expect lots of overlapping and some really broken looking shapes)
+	createRandomScene(100, 100, 630.0f, 470.0f);
+}
+
+void RayTracer::createRandomScene(int sphereCount, int cubeCount, float areaWidth, float areaHeight)
+{
+	for (int sphereIndex = 0; sphereIndex < sphereCount; sphereIndex++)
+	{
+		sphereOrigins.push_back(glm::vec4(
+			Random::getFloat(0.0f, areaWidth),
+			Random::getFloat(0.0f, areaHeight), 
+			-Random::getFloat(20.0f, 100.0f), 
+			1.0f
+		));
+		
+		sphereRadius.push_back(Random::getFloat(5.0f, 30.0f));
+
+		sphereColours.push_back(glm::vec4(
+			Random::getFloat(0.05f, 1.0f),
+			Random::getFloat(0.05f, 1.0f),
+			Random::getFloat(0.05f, 1.0f),
+			255.0f));
+	}
+
+	for (int cubeIndex = 0; cubeIndex < cubeCount; cubeIndex++)
+	{
+		Cube cube(glm::vec4(
+			Random::getFloat(0.05f, 1.0f),
+			Random::getFloat(0.05f, 1.0f),
+			Random::getFloat(0.05f, 1.0f),
+			255.0f));
+
+		cube.scale(glm::vec3(Random::getFloat(5.0f, 30.0f)));
+
+		cube.rotate(glm::vec3(0.0f, 0.0f, Utility::convertAngleToRadian(Random::getFloat(0.0f, 359.0f))));
+		cube.rotate(glm::vec3(0.0f, Utility::convertAngleToRadian(Random::getFloat(0.0f, 359.0f)), 0.0f));
+		cube.rotate(glm::vec3(Utility::convertAngleToRadian(Random::getFloat(0.0f, 359.0f)), 0.0f, 0.0f));
+
+		cube.translate(glm::vec3(
+			Random::getFloat(0.0f, areaWidth),
+			Random::getFloat(0.0f, areaHeight),
+			-Random::getFloat(30.0f, 100.0f)
+		));
+
+		cubes.push_back(cube);
+	}
+}
+
+void RayTracer::executeRayTracerOpenCL(size_t deviceCount)
+{
+	if (!openCLAvailable)
+	{
+		std::cout << "OpenCL is not available, skipping render" << std::endl;
+		timeTaken = 0;
+		return;
+	}
+
+	finishOpenCLFrames();
+
+	std::cout << "OpenCL Ray Tracer Begin (" << deviceCount << " device" << (deviceCount > 1 ? "s" : "") << ")" << std::endl;
+
+	//OpenCL Starts
+	timer.startCounter();
+
+	beginOpenCLFrame(deviceCount, height, deviceCount > 1 ? "OpenCL Multi Device" : "OpenCL");
+
+	uint64_t enqueueTime = timer.lap();
+
+	//Retrieve results of the processing (Will block execution until each band is returned)
+	finishOpenCLFrame();
+
+	uint64_t kernelTime = timer.lap();
+	std::cout << "Enqueue: " << (enqueueTime / 1000) << " microseconds, Upload + Kernel + Readback: " << (kernelTime / 1000) << " microseconds" << std::endl;
+
+	//Calculate Timer
+	stopTimer(deviceCount > 1 ? "OpenCL Multi Device" : "OpenCL");
+}
+
+void RayTracer::beginOpenCLFrame(size_t deviceCount, int rowCount, std::string modeName)
+{
+	int bufferIndex = nextOpenCLFrame;
+	copyPresentedHostFrame(bufferIndex);
+
+	OpenCLFrame& frame = openCLFrames[bufferIndex];
+	frame.timer.startCounter();
+	frame.startTime = PerformanceCounter::getTimestampNanoseconds();
+	frame.modeName = modeName;
+	frame.deviceCount = deviceCount;
+
+	for (size_t deviceIndex = 0; deviceIndex < deviceCount; deviceIndex++)
+	{
+		prepareOpenCLDevice(openCLDevices[deviceIndex]);
+	}
+
+	//Start every device on its band before waiting on any of them so they all run at once
+	frame.bandRows = getOpenCLBandRows(deviceCount, rowCount);
+	int firstRow = 0;
+	for (size_t deviceIndex = 0; deviceIndex < deviceCount; deviceIndex++)
+	{
+		openCLDevices[deviceIndex]->beginBand(bufferIndex, firstRow, frame.bandRows[deviceIndex]);
+		firstRow += frame.bandRows[deviceIndex];
+	}
+
+	nextOpenCLFrame = (nextOpenCLFrame + 1) % OpenCLDevice::BUFFER_COUNT;
+	openCLFramesInFlight++;
+}
+
+bool RayTracer::isOpenCLFrameReady()
+{
+	int bufferIndex = getOldestOpenCLFrame();
+	const OpenCLFrame& frame = openCLFrames[bufferIndex];
+
+	for (size_t deviceIndex = 0; deviceIndex < frame.deviceCount; deviceIndex++)
+	{
+		if (!openCLDevices[deviceIndex]->isBandReady(bufferIndex))
+			return false;
+	}
+
+	return true;
+}
+
+uint64_t RayTracer::finishOpenCLFrame()
+{
+	int bufferIndex = getOldestOpenCLFrame();
+	const OpenCLFrame& frame = openCLFrames[bufferIndex];
+	size_t deviceCount = frame.deviceCount;
+
+	//A single device rendering the whole frame into host memory leaves it there to be presented,
+	// otherwise every band is copied into the pixel array
+	unsigned char* destination = pixels.data();
+	if (deviceCount == 1 && frame.bandRows[0] == height && openCLDevices[0]->getHostFrame(bufferIndex) != nullptr)
+		destination = openCLDevices[0]->getHostFrame(bufferIndex);
+
+	std::vector<uint64_t> kernelTimes(deviceCount, 0);
+	for (size_t deviceIndex = 0; deviceIndex < deviceCount; deviceIndex++)
+	{
+		kernelTimes[deviceIndex] = openCLDevices[deviceIndex]->finishBand(bufferIndex, destination);
+	}
+
+	framePixels = destination;
+
+	openCLFramesInFlight--;
+
+	//The devices run side by side so the frame's kernel time is the slowest one's
+	openCLProfile = OpenCLProfile();
+	uint64_t frameTime = 0;
+	for (size_t deviceIndex = 0; deviceIndex < deviceCount; deviceIndex++)
+	{
+		const OpenCLProfile& deviceProfile = openCLDevices[deviceIndex]->getBandProfile(bufferIndex);
+		openCLProfile.write += deviceProfile.write;
+		openCLProfile.writeCount += deviceProfile.writeCount;
+		openCLProfile.kernel = std::max(openCLProfile.kernel, deviceProfile.kernel);
+		openCLProfile.map += deviceProfile.map;
+		openCLProfile.unmap += deviceProfile.unmap;
+
+		uint64_t readyTime = openCLDevices[deviceIndex]->getBandReadyTime(bufferIndex);
+		if (readyTime > frame.startTime)
+			frameTime = std::max(frameTime, readyTime - frame.startTime);
+
+		if (deviceCount > 1)
+		{
+			std::cout << " - " << openCLDevices[deviceIndex]->getName() << ": " << frame.bandRows[deviceIndex] << " rows, Kernel: "
+				<< (kernelTimes[deviceIndex] / 1000) << " microseconds" << std::endl;
+		}
+	}
+
+	std::cout << "OpenCL Profile - Write (" << openCLProfile.writeCount << " buffers): " << (openCLProfile.write / 1000)
+		<< " microseconds, Kernel: " << (openCLProfile.kernel / 1000)
+		<< " microseconds, Map: " << (openCLProfile.map / 1000)
+		<< " microseconds, Unmap (previous frame): " << (openCLProfile.unmap / 1000) << " microseconds" << std::endl;
+
+	if (deviceCount > 1)
+		balanceOpenCLBands(frame.bandRows, kernelTimes);
+
+	return frameTime;
+}
+
+void RayTracer::finishOpenCLFrames()
+{
+	finishTuneWorkGroupSize();
+
+	if (hybridFrameInProgress)
+		finishHybridFrame();
+
+	while (openCLFramesInFlight > 0)
+	{
+		finishOpenCLFrame();
+	}
+}
+
+void RayTracer::copyPresentedHostFrame(int bufferIndex)
+{
+	if (framePixels == nullptr || framePixels == pixels.data())
+		return;
+
+	for (OpenCLDevice* device : openCLDevices)
+	{
+		if (device->getHostFrame(bufferIndex) == framePixels)
+		{
+			memcpy(pixels.data(), framePixels, pixelCount * 4);
+			framePixels = pixels.data();
+			return;
+		}
+	}
+}
+
+void RayTracer::prepareOpenCLDevice(OpenCLDevice* device)
+{
+	//Buffers stay on the device between renders, only upload what has changed
+	if (!device->hasFrameBuffers(width, height))
+		device->createFrameBuffers(width, height, rayDir);
+
+	if (!device->isSceneUploaded())
+		device->uploadScene(sceneView);
+}
+
+void RayTracer::initOpenCLMultiDevice()
+{
+	openCLMultiDeviceInitialised = true;
+
+	for (cl_device_id deviceID : openCLDeviceIDs)
+	{
+		if (deviceID == openCLSelectedDeviceID)
+			continue;
+
+		//Each device gets its own context as they may be on different platforms
+		OpenCLDevice* device = new OpenCLDevice(deviceID);
+		std::cout << "OpenCL multi device mode adding device: " << device->getName() << std::endl;
+
+		if (!device->init(openCLSource, openCLBuildOptions))
+		{
+			std::cout << "OpenCL device " << device->getName() << " could not be set up, it won't be used" << std::endl;
+			delete device;
+			continue;
+		}
+
+		openCLDevices.push_back(device);
+	}
+
+	openCLBandShares.assign(openCLDevices.size(), 1.0f / openCLDevices.size());
+}
+
+std::vector<int> RayTracer::getOpenCLBandRows(size_t deviceCount, int rowCount)
+{
+	if (openCLBandShares.size() != deviceCount)
+		openCLBandShares.assign(deviceCount, 1.0f / deviceCount);
+
+	std::vector<int> bandRows(deviceCount, 0);
+	int rowsLeft = rowCount;
+
+	for (size_t deviceIndex = 0; deviceIndex < deviceCount; deviceIndex++)
+	{
+		int devicesLeft = (int)(deviceCount - deviceIndex - 1);
+
+		//The last device takes whatever is left so rounding never drops a row
+		int rows = rowsLeft;
+		if (devicesLeft > 0)
+		{
+			rows = std::max(1, (int)(openCLBandShares[deviceIndex] * rowCount + 0.5f));
+			rows = std::min(rows, std::max(0, rowsLeft - devicesLeft));
+		}
+
+		bandRows[deviceIndex] = rows;
+		rowsLeft -= rows;
+	}
+
+	return bandRows;
+}
+
+void RayTracer::balanceOpenCLBands(const std::vector<int>& bandRows, const std::vector<uint64_t>& kernelTimes)
+{
+	std::vector<float> throughputs(bandRows.size(), 0.0f);
+	float totalThroughput = 0.0f;
+
+	for (size_t deviceIndex = 0; deviceIndex < bandRows.size(); deviceIndex++)
+	{
+		//Without a time for every device there is nothing to compare, keep the current split
+		if (kernelTimes[deviceIndex] == 0 || bandRows[deviceIndex] == 0)
+			return;
+
+		throughputs[deviceIndex] = (float)bandRows[deviceIndex] / (float)kernelTimes[deviceIndex];
+		totalThroughput += throughputs[deviceIndex];
+	}
+
+	for (size_t deviceIndex = 0; deviceIndex < bandRows.size(); deviceIndex++)
+	{
+		openCLBandShares[deviceIndex] = smoothShare(openCLBandShares[deviceIndex], throughputs[deviceIndex] / totalThroughput);
+	}
+}
+
+float RayTracer::smoothShare(float share, float measuredShare)
+{
+	//Only move part of the way so one noisy frame doesn't throw the split off
+	const float smoothing = 0.5f;
+	return share + (measuredShare - share) * smoothing;
+}
+
+bool RayTracer::setWorkGroupSize(int groupWidth, int groupHeight)
+{
+	if (!openCLAvailable || workGroupTuning.valid())
+		return false;
+
+	//Sub-devices are parts of the same device so they all share its work-group size
+	for (size_t deviceIndex = 0; deviceIndex < openCLSelectedDeviceCount; deviceIndex++)
+	{
+		if (!openCLDevices[deviceIndex]->setWorkGroupSize(groupWidth, groupHeight))
+			return false;
+	}
+
+	return true;
+}
+
+bool RayTracer::tuneWorkGroupSize()
+{
+	if (!openCLAvailable || workGroupTuning.valid())
+		return false;
+
+	prepareTuneWorkGroupSize();
+	openCLDevices[0]->tuneWorkGroupSize();
+
+	return setWorkGroupSize(openCLDevices[0]->getWorkGroupWidth(), openCLDevices[0]->getWorkGroupHeight());
+}
+
+bool RayTracer::beginTuneWorkGroupSize()
+{
+	if (!openCLAvailable || workGroupTuning.valid())
+		return false;
+
+	prepareTuneWorkGroupSize();
+
+	//Runs every candidate several times, long enough to stall whoever waits on it. The worker only touches
+	// the device, everything else the ray tracer shares is left to this thread
+	OpenCLDevice* device = openCLDevices[0];
+	workGroupTuning = std::async(std::launch::async, [device]() { device->tuneWorkGroupSize(); });
+	return true;
+}
+
+bool RayTracer::pollTuneWorkGroupSize(bool& tuned)
+{
+	if (!workGroupTuning.valid() || workGroupTuning.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		return false;
+
+	tuned = finishTuneWorkGroupSize();
+	return true;
+}
+
+void RayTracer::prepareTuneWorkGroupSize()
+{
+	finishOpenCLFrames();
+	copyPresentedHostFrame(0);
+	prepareOpenCLDevice(openCLDevices[0]);
+}
+
+bool RayTracer::finishTuneWorkGroupSize()
+{
+	if (!workGroupTuning.valid())
+		return false;
+
+	workGroupTuning.get();
+
+	return setWorkGroupSize(openCLDevices[0]->getWorkGroupWidth(), openCLDevices[0]->getWorkGroupHeight());
+}
+
+std::string RayTracer::getOpenCLDeviceName()
+{
+	if (openCLDevices.empty())
+		return "";
+
+	return openCLDevices[0]->getName();
+}
+
+void RayTracer::executeRayTracerCPU()
+{
+	std::cout << "CPU Ray Tracer Begin" << std::endl;
+	timer.startCounter();
+
+	//Neighbouring pixels in a row are traced together as packets
+	for (int y = 0; y < height; y++)
+	{
+		traceRow(y, 0, width);
+	}
+
+
+	//Calculate Timer
+	stopTimer("CPU");
+}
+
+void RayTracer::executeRayTracerCPUParallel()
+{
+	std::cout << "CPU Parallel Ray Tracer Begin (" << threadPool->getThreadCount() << " threads)" << std::endl;
+	timer.startCounter();
+
+	traceRowsParallel(0, height);
+
+	//Calculate Timer
+	stopTimer("CPU Parallel");
+}
+
+void RayTracer::traceRowsParallel(int firstRow, int endRow)
+{
+	beginTraceRowsParallel(firstRow, endRow);
+	threadPool->waitForBatch();
+}
+
+void RayTracer::beginTraceRowsParallel(int firstRow, int endRow)
+{
+	tileFirstRow = firstRow;
+	tileEndRow = endRow;
+	tilesX = (width + tileSize - 1) / tileSize;
+	int tilesY = (endRow - firstRow + tileSize - 1) / tileSize;
+
+	//Each tile writes to its own pixels so no locking is needed
+	threadPool->beginBatch(tilesX * tilesY, traceTile, this);
+}
+
+void RayTracer::traceTile(void* rayTracer, int tileIndex)
+{
+	RayTracer* self = (RayTracer*)rayTracer;
+
+	int startX = (tileIndex % self->tilesX) * self->tileSize;
+	int startY = self->tileFirstRow + (tileIndex / self->tilesX) * self->tileSize;
+	int endX = std::min(startX + self->tileSize, self->width);
+	int endY = std::min(startY + self->tileSize, self->tileEndRow);
+
+	for (int y = startY; y < endY; y++)
+	{
+		self->traceRow(y, startX, endX);
+	}
+}
+
+void RayTracer::executeRayTracerHybrid()
+{
+	if (!openCLAvailable)
+	{
+		std::cout << "OpenCL is not available, rendering the whole frame on the CPU" << std::endl;
+		executeRayTracerCPUParallel();
+		return;
+	}
+
+	finishOpenCLFrames();
+
+	std::cout << "Hybrid Ray Tracer Begin (" << threadPool->getThreadCount() << " threads, "
+		<< openCLSelectedDeviceCount << " OpenCL device" << (openCLSelectedDeviceCount > 1 ? "s" : "") << ")" << std::endl;
+	timer.startCounter();
+
+	beginHybridFrame();
+	finishHybridFrame();
+
+	//Calculate Timer
+	stopTimer("Hybrid");
+}
+
+void RayTracer::beginHybridFrame()
+{
+	//OpenCL takes the top of the frame and the CPU the rest
+	hybridOpenCLRows = getHybridOpenCLRows(hybridOpenCLShare, height);
+
+	//The device works through its band while the thread pool traces the CPU's
+	beginOpenCLFrame(openCLSelectedDeviceCount, hybridOpenCLRows, "Hybrid");
+	beginTraceRowsParallel(hybridOpenCLRows, height);
+
+	hybridFrameInProgress = true;
+}
+
+void RayTracer::finishHybridFrame()
+{
+	//Both sides are timed on the host clock from when they were started to when their rows were ready,
+	// so OpenCL's includes the enqueue, uploads and driver latency as well as the kernel
+	uint64_t openCLTime = finishOpenCLFrame();
+	threadPool->waitForBatch();
+	uint64_t cpuTime = threadPool->getBatchNanoseconds();
+
+	hybridFrameInProgress = false;
+
+	int openCLRows = hybridOpenCLRows;
+	int cpuRows = height - openCLRows;
+	std::cout << "CPU: " << cpuRows << " rows in " << (cpuTime / 1000)
+		<< " microseconds, OpenCL: " << openCLRows << " rows in " << (openCLTime / 1000) << " microseconds" << std::endl;
+
+	//Move the split towards where both sides would have finished together
+	if (cpuTime > 0 && openCLTime > 0 && cpuRows > 0 && openCLRows > 0)
+	{
+		float cpuThroughput = (float)cpuRows / (float)cpuTime;
+		float openCLThroughput = (float)openCLRows / (float)openCLTime;
+		hybridOpenCLShare = smoothShare(hybridOpenCLShare, openCLThroughput / (openCLThroughput + cpuThroughput));
+	}
+}
+
+int RayTracer::getHybridOpenCLRows(float share, int rowCount)
+{
+	int rows = (int)(share * rowCount + 0.5f);
+	return std::max(std::min(rows, rowCount - 1), std::min(1, rowCount));
+}
+
+void RayTracer::stopTimer(std::string modeName)
+{
+	timeTaken = timer.stopCounter();
+
+	logTimeTaken(modeName);
+}
+
+void RayTracer::logTimeTaken(std::string modeName)
+{
+	if (!logTimings)
+		return;
+
+	std::cout << "Time Taken: " << timeTaken << " microseconds" << std::endl;
+	std::cout << "Memory - " << MemoryCounter::getReport() << std::endl;
+	std::cout << modeName << " Ray Trace Finished (Timer Stopped), Converting data to pixels" << std::endl << std::endl;
+}
+
+std::string RayTracer::loadComputeShaderFromFile(std::string path)
+{
+	std::string shader;
+	std::ifstream file(path, std::ios::in);
+
+	if (!file.is_open())
+	{
+		std::cout << "Compute Shader couldn't be opened: " << path << std::endl;
+		return "";
+	}
+
+	std::string line;
+	while (!file.eof())
+	{
+		//file.getline(line,(std::streamsize) 2000);
+		std::getline(file, line);
+		line.append("\n");
+		shader.append(line);
+
+		//char line[512];
+		//file.getline(line, 511);
+		//shader += line;
+	}
+	file.close();
+
+	return shader;
+}
+
+std::vector<cl_device_id> RayTracer::enumerateOpenCLDevices()
+{
+	std::vector<cl_device_id> allDevices;
+
+	cl_uint numPlatforms = 0;
+	cl_int error = clGetPlatformIDs(0, NULL, &numPlatforms);
+	if (error != CL_SUCCESS || numPlatforms == 0)
+	{
+		std::cout << "No OpenCL platforms found, errorcode " << error << std::endl;
+		return allDevices;
+	}
+
+	std::vector<cl_platform_id> platformIDs(numPlatforms);
+	clGetPlatformIDs(numPlatforms, platformIDs.data(), NULL);
+	std::cout << "Number of OpenCL Platforms: " << numPlatforms << std::endl;
+
+	for (unsigned int platformIndex = 0; platformIndex < numPlatforms; platformIndex++)
+	{
+		std::cout << "Platform " << platformIndex << ": " << std::endl;
+		char words[1000];
+		clGetPlatformInfo(platformIDs[platformIndex], CL_PLATFORM_NAME, 1000, words, NULL);
+		std::cout << " - Name: " << words << std::endl;
+		clGetPlatformInfo(platformIDs[platformIndex], CL_PLATFORM_VERSION, 1000, words, NULL);
+		std::cout << " - Version: " << words << std::endl;
+		clGetPlatformInfo(platformIDs[platformIndex], CL_PLATFORM_PROFILE, 1000, words, NULL);
+		std::cout << " - Profile: " << words << std::endl;
+		clGetPlatformInfo(platformIDs[platformIndex], CL_PLATFORM_VENDOR, 1000, words, NULL);
+		std::cout << " - Vendor: " << words << std::endl;
+		clGetPlatformInfo(platformIDs[platformIndex], CL_PLATFORM_EXTENSIONS, 1000, words, NULL);
+		std::cout << " - Extensions: " << words << std::endl << std::endl;
+
+		cl_uint numDevices = 0;
+		error = clGetDeviceIDs(platformIDs[platformIndex], CL_DEVICE_TYPE_ALL, 0, NULL, &numDevices);
+		if (error != CL_SUCCESS || numDevices == 0)
+		{
+			std::cout << " - No OpenCL Devices, errorcode " << error << std::endl << std::endl;
+			continue;
+		}
+
+		std::vector<cl_device_id> devices(numDevices);
+		clGetDeviceIDs(platformIDs[platformIndex], CL_DEVICE_TYPE_ALL, numDevices, devices.data(), NULL);
+
+		std::cout << " - Number of OpenCL Devices: " << numDevices << std::endl;
+		for (cl_device_id device : devices)
+		{
+			//Devices are numbered across every platform so one index picks any of them
+			logOpenCLDeviceCapabilities(device, (int)allDevices.size());
+			allDevices.push_back(device);
+		}
+	}
+
+	return allDevices;
+}
+
+void RayTracer::logOpenCLDeviceCapabilities(cl_device_id device, int deviceIndex)
+{
+	char words[1000];
+	cl_bool boolean = false;
+	cl_uint uInt = 0;
+	cl_ulong uLong = 0;
+	size_t size = 0;
+
+	std::cout << "-- Device Index: " << deviceIndex << std::endl;
+	clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(words), words, NULL);
+	std::cout << " -- Name: " << words << std::endl;
+
+	cl_device_type deviceType = 0;
+	clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof(cl_device_type), &deviceType, NULL);
+	std::cout << " -- Type: " << OpenCLDevice::deviceTypeToString(deviceType) << std::endl;
+
+	clGetDeviceInfo(device, CL_DEVICE_VERSION, sizeof(words), words, NULL);
+	std::cout << " -- Version: " << words << std::endl;
+
+	clGetDeviceInfo(device, CL_DRIVER_VERSION, sizeof(words), words, NULL);
+	std::cout << " -- Driver Version: " << words << std::endl;
+
+	clGetDeviceInfo(device, CL_DEVICE_AVAILABLE, sizeof(cl_bool), &boolean, NULL);
+	std::cout << " -- Is Available: " << boolean << std::endl;
+
+	clGetDeviceInfo(device, CL_DEVICE_MAX_CLOCK_FREQUENCY, sizeof(cl_uint), &uInt, NULL);
+	std::cout << " -- Max Clock Frequency: " << uInt << "MHz" << std::endl;
+
+	clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cl_uint), &uInt, NULL);
+	std::cout << " -- Max Compute Units: " << uInt << std::endl;
+
+	clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t), &size, NULL);
+	std::cout << " -- Max Work Group Size: " << size << std::endl;
+
+	uInt = 0;
+	clGetDeviceInfo(device, CL_DEVICE_PARTITION_MAX_SUB_DEVICES, sizeof(cl_uint), &uInt, NULL);
+	std::cout << " -- Max Sub-Devices: " << uInt << std::endl;
+
+	clGetDeviceInfo(device, CL_DEVICE_GLOBAL_MEM_SIZE, sizeof(cl_ulong), &uLong, NULL);
+	std::cout << " -- Global Memory: " << (uLong / (1024 * 1024)) << "MB" << std::endl;
+
+	clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong), &uLong, NULL);
+	std::cout << " -- Local Memory: " << (uLong / 1024) << "KB" << std::endl;
+
+	//Vector widths the compiler prefers, a CPU device wants these filled to use its SIMD units
+	cl_uint charWidth = 0, shortWidth = 0, intWidth = 0, longWidth = 0, floatWidth = 0, doubleWidth = 0;
+	clGetDeviceInfo(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR, sizeof(cl_uint), &charWidth, NULL);
+	clGetDeviceInfo(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_SHORT, sizeof(cl_uint), &shortWidth, NULL);
+	clGetDeviceInfo(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT, sizeof(cl_uint), &intWidth, NULL);
+	clGetDeviceInfo(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_LONG, sizeof(cl_uint), &longWidth, NULL);
+	clGetDeviceInfo(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT, sizeof(cl_uint), &floatWidth, NULL);
+	clGetDeviceInfo(device, CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE, sizeof(cl_uint), &doubleWidth, NULL);
+	std::cout << " -- Preferred Vector Widths: char " << charWidth << ", short " << shortWidth << ", int " << intWidth
+		<< ", long " << longWidth << ", float " << floatWidth << ", double " << doubleWidth << std::endl << std::endl;
+}
+
+cl_device_id RayTracer::selectOpenCLDevice(const std::vector<cl_device_id>& devices, std::string selection)
+{
+	std::string lowerSelection = selection;
+	std::transform(lowerSelection.begin(), lowerSelection.end(), lowerSelection.begin(), ::tolower);
+
+	//By default use the first GPU, or the first device if there isn't one
+	if (lowerSelection.empty() || lowerSelection == "auto")
+	{
+		cl_device_id gpu = selectOpenCLDevice(devices, "gpu");
+		if (gpu != nullptr)
+			return gpu;
+
+		std::cout << "No GPU Found, OpenCL will attempt fallback to device 0" << std::endl;
+		return devices[0];
+	}
+
+	//An index into the list logged by enumerateOpenCLDevices()
+	if (lowerSelection.find_first_not_of("0123456789") == std::string::npos)
+	{
+		size_t deviceIndex = (size_t)atoi(lowerSelection.c_str());
+		return (deviceIndex < devices.size()) ? devices[deviceIndex] : nullptr;
+	}
+
+	cl_device_type wantedType = 0;
+	if (lowerSelection == "gpu")
+		wantedType = CL_DEVICE_TYPE_GPU;
+	else if (lowerSelection == "cpu")
+		wantedType = CL_DEVICE_TYPE_CPU;
+	else if (lowerSelection == "accelerator")
+		wantedType = CL_DEVICE_TYPE_ACCELERATOR;
+
+	for (cl_device_id device : devices)
+	{
+		if (wantedType != 0)
+		{
+			cl_device_type deviceType = 0;
+			clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof(cl_device_type), &deviceType, NULL);
+			if (deviceType & wantedType)
+				return device;
+		}
+		else
+		{
+			//Anything else is part of the device or platform name e.g. "GeForce" or "Portable Computing Language"
+			char name[1000] = "";
+			char platformName[1000] = "";
+			cl_platform_id platformID = nullptr;
+			clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(name), name, NULL);
+			clGetDeviceInfo(device, CL_DEVICE_PLATFORM, sizeof(cl_platform_id), &platformID, NULL);
+			clGetPlatformInfo(platformID, CL_PLATFORM_NAME, sizeof(platformName), platformName, NULL);
+
+			std::string lowerName = std::string(name) + " " + platformName;
+			std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), ::tolower);
+			if (lowerName.find(lowerSelection) != std::string::npos)
+				return device;
+		}
+	}
+
+	return nullptr;
+}
+
+bool RayTracer::openCLInit()
+{
+	//OpenCL Init
+	bool clpresent = 0 == clewInit();
+	if (!clpresent)
+	{
+		std::cout << "Open CL Library not found, OpenCL mode disabled" << std::endl;
+		return false;
+	}
+
+	openCLDeviceIDs = enumerateOpenCLDevices();
+	if (openCLDeviceIDs.empty())
+	{
+		std::cout << "No OpenCL devices found, OpenCL mode disabled" << std::endl;
+		return false;
+	}
+
+	cl_device_id deviceID = selectOpenCLDevice(openCLDeviceIDs, openCLDeviceSelection);
+	if (deviceID == nullptr)
+	{
+		std::cout << "No OpenCL device matches \"" << openCLDeviceSelection << "\", OpenCL mode disabled" << std::endl;
+		return false;
+	}
+
+	openCLSelectedDeviceID = deviceID;
+
+	//The intersection code is shared with the CPU ray tracers so goes in front of the kernel, pasted in
+	// rather than #included as some drivers cache programs without checking included files.
+	//Kept so the other devices can be built the same way if multi device mode is used
+	openCLSource = loadComputeShaderFromFile("resources/shaders/Intersect.h")
+		+ "#line 1\n"
+		+ loadComputeShaderFromFile("resources/shaders/rayTracer.cl");
+
+	//The kernel's traversal stack has to be as deep as the host builds the BVH
+	openCLBuildOptions = "-D BVH_MAX_DEPTH=" + Utility::intToString(BVH::MAX_DEPTH);
+
+	//The kernel finds each triangle component array from the padded stride
+	openCLBuildOptions += " -D TRIANGLE_STRIDE_MULTIPLE=" + Utility::intToString(TriangleStore::STRIDE_MULTIPLE);
+
+	//A sub-device that can't be set up would leave part of every frame unrendered, so all of them are dropped for the whole device
+	openCLSubDeviceIDs = partitionOpenCLDevice(deviceID, openCLFission);
+	if (!openCLSubDeviceIDs.empty() && !initOpenCLDevices(openCLSubDeviceIDs))
+	{
+		std::cout << "OpenCL could not set up every sub-device, using the whole device" << std::endl;
+
+		for (cl_device_id subDeviceID : openCLSubDeviceIDs)
+		{
+			clReleaseDevice(subDeviceID);
+		}
+		openCLSubDeviceIDs.clear();
+	}
+
+	if (openCLSubDeviceIDs.empty() && !initOpenCLDevices(std::vector<cl_device_id>(1, deviceID)))
+		return false;
+
+	openCLSelectedDeviceCount = openCLDevices.size();
+	return true;
+}
+
+bool RayTracer::initOpenCLDevices(const std::vector<cl_device_id>& deviceIDs)
+{
+	//Sub-devices get a context, queue and scene copy each, so a NUMA node's copy is allocated by the threads that read it
+	for (cl_device_id deviceID : deviceIDs)
+	{
+		OpenCLDevice* device = new OpenCLDevice(deviceID);
+		std::cout << "OpenCL using device: " << device->getName() << std::endl << std::endl;
+
+		if (!device->init(openCLSource, openCLBuildOptions))
+		{
+			delete device;
+
+			for (OpenCLDevice* initialisedDevice : openCLDevices)
+			{
+				delete initialisedDevice;
+			}
+			openCLDevices.clear();
+
+			return false;
+		}
+
+		openCLDevices.push_back(device);
+	}
+
+	return true;
+}
+
+std::vector<cl_device_id> RayTracer::partitionOpenCLDevice(cl_device_id device, std::string fission)
+{
+	std::vector<cl_device_id> subDevices;
+
+	std::string lowerFission = fission;
+	std::transform(lowerFission.begin(), lowerFission.end(), lowerFission.begin(), ::tolower);
+	if (lowerFission.empty() || lowerFission == "none")
+		return subDevices;
+
+	//A GPU already spreads work over its compute units, splitting it would only add queues
+	cl_device_type deviceType = 0;
+	clGetDeviceInfo(device, CL_DEVICE_TYPE, sizeof(cl_device_type), &deviceType, NULL);
+	if (!(deviceType & CL_DEVICE_TYPE_CPU))
+	{
+		std::cout << "OpenCL device fission is only used on CPU devices, using the whole device" << std::endl;
+		return subDevices;
+	}
+
+	cl_uint computeUnits = 0;
+	clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cl_uint), &computeUnits, NULL);
+
+	std::vector<cl_device_partition_property> properties;
+	if (lowerFission == "numa")
+	{
+		//One sub-device per NUMA node, so each node's threads work on their own part of the frame
+		properties = { CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN, CL_DEVICE_AFFINITY_DOMAIN_NUMA, 0 };
+	}
+	else if (lowerFission.find_first_not_of("0123456789") == std::string::npos)
+	{
+		cl_uint subDeviceCount = (cl_uint)atoi(lowerFission.c_str());
+		if (subDeviceCount < 2 || subDeviceCount > computeUnits)
+		{
+			std::cout << "OpenCL device fission into " << subDeviceCount << " sub-devices is invalid for a device with "
+				<< computeUnits << " compute units, using the whole device" << std::endl;
+			return subDevices;
+		}
+
+		//Partitioning equally would make as many sub-devices of computeUnits / N as fit, which can be more than N
+		properties.push_back(CL_DEVICE_PARTITION_BY_COUNTS);
+		for (cl_uint count : splitComputeUnits(computeUnits, subDeviceCount))
+		{
+			properties.push_back((cl_device_partition_property)count);
+		}
+		properties.push_back(CL_DEVICE_PARTITION_BY_COUNTS_LIST_END);
+		properties.push_back(0);
+	}
+	else
+	{
+		std::cout << "Unknown OpenCL device fission \"" << fission << "\", using the whole device" << std::endl;
+		return subDevices;
+	}
+
+	cl_uint numSubDevices = 0;
+	cl_int error = clCreateSubDevices(device, properties.data(), 0, NULL, &numSubDevices);
+	if (error != CL_SUCCESS || numSubDevices == 0)
+	{
+		std::cout << "OpenCL could not split the device into sub-devices, errorcode: " << OpenCLDevice::getErrorString(error)
+			<< ", using the whole device" << std::endl;
+		return subDevices;
+	}
+
+	subDevices.resize(numSubDevices);
+	error = clCreateSubDevices(device, properties.data(), numSubDevices, subDevices.data(), NULL);
+	if (error != CL_SUCCESS)
+	{
+		std::cout << "OpenCL could not split the device into sub-devices, errorcode: " << OpenCLDevice::getErrorString(error)
+			<< ", using the whole device" << std::endl;
+		subDevices.clear();
+		return subDevices;
+	}
+
+	std::cout << "OpenCL device split into " << numSubDevices << " sub-devices:" << std::endl;
+	for (cl_device_id subDevice : subDevices)
+	{
+		cl_uint subComputeUnits = 0;
+		clGetDeviceInfo(subDevice, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cl_uint), &subComputeUnits, NULL);
+		std::cout << " - " << subComputeUnits << " compute units" << std::endl;
+	}
+
+	return subDevices;
+}
+
+std::vector<cl_uint> RayTracer::splitComputeUnits(cl_uint computeUnits, cl_uint subDeviceCount)
+{
+	//The remainder goes one each to the first sub-devices
+	std::vector<cl_uint> counts(subDeviceCount, computeUnits / subDeviceCount);
+	for (cl_uint subDeviceIndex = 0; subDeviceIndex < computeUnits % subDeviceCount; subDeviceIndex++)
+	{
+		counts[subDeviceIndex]++;
+	}
+
+	return counts;
+}
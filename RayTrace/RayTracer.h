@@ -0,0 +1,771 @@
+#pragma once
+
+#include <future>
+#include <string>
+#include <vector>
+#include <clew.h>
+
+#include "glm/glm.hpp"
+#include "Ray.h"
+#include "Cube.h"
+#include "BVH.h"
+#include "PacketIntersect.h"
+#include "SceneView.h"
+#include "TriangleStore.h"
+#include "OpenCLDevice.h"
+#include "misc/PerformanceCounter.h"
+#include "misc/MemoryCounter.h"
+#include "misc/ThreadPool.h"
+
+/**
+@brief	The ray tracer, holds the scene and renders it on the CPU or with OpenCL into a pixel array.
+	Doesn't depend on a window so it can be driven by MainState or run headless.
+*/
+class RayTracer
+{
+public:
+
+	/** @brief	Modes of the ray tracer. */
+	enum Mode
+	{
+		CPU,
+		CPUParallel,
+		OpenCL,
+		OpenCLMultiDevice,
+		Hybrid
+	};
+
+	/** @brief	Precisions the CPU ray tracers can intersect rays at. */
+	enum Precision
+	{
+		/** @brief	Single precision, the same as the OpenCL kernel. */
+		Single,
+		/** @brief	Double precision, a slower reference to validate single precision against. */
+		Double
+	};
+
+	/**
+	 @brief	Constructor.
+	
+	 @param	width			The width of the image in pixels.
+	 @param	height			The height of the image in pixels.
+	 @param	openCLDevice	The OpenCL device to use: an index from the device list in the log, "gpu", "cpu",
+	 						"accelerator", part of a device or platform name, or empty/"auto" for the first GPU.
+	 @param	openCLFission	How to split a CPU OpenCL device into sub-devices that each render part of the frame:
+	 						"numa" for one per NUMA node, a number of sub-devices, or empty/"none" to use it whole.
+	 */
+	RayTracer(int width, int height, std::string openCLDevice = "", std::string openCLFission = "");
+
+	/** @brief	Destructor. */
+	~RayTracer();
+
+	/**
+	 @brief	Builds one of the built in scenes, replacing the current one.
+	
+	 @param	sceneNumber	The scene number (1 to 3).
+	 
+	 @return	false if the scene doesn't exist.
+	 */
+	bool setScene(int sceneNumber);
+
+	/**
+	 @brief	Builds a randomly generated scene like scene 3 but with any number of objects, for stress testing.
+		Seed Random beforehand to get the same scene every time.
+	
+	 @param	objectCount	Number of spheres and number of cubes.
+	 */
+	void setSyntheticScene(int objectCount);
+
+	/**
+	 @brief	Renders the current scene into the pixel array and times it.
+	
+	 @param	mode	The mode to render with.
+	 */
+	void render(Mode mode);
+
+	/**
+	 @brief	Starts rendering the current scene with OpenCL without waiting for it, poll with pollRenderAsync().
+		Each frame in flight renders into its own output buffers, so the next frame can be started while the
+		last one is still being read back. A hybrid frame's CPU rows are traced by the thread pool meanwhile,
+		so it can't share the pixel array with another frame in flight.
+	
+	 @param	mode	The mode to render with, OpenCL, OpenCLMultiDevice or Hybrid.
+	
+	 @return	false if the mode can't render asynchronously, OpenCL isn't available or every output buffer is in use.
+	 */
+	bool beginRenderAsync(Mode mode);
+
+	/**
+	 @brief	Checks if the oldest frame started by beginRenderAsync() has been read back, and for a hybrid frame
+		if the CPU rows are done, without blocking.
+		If it has its pixels are copied into the pixel array and the time taken and profile are updated.
+	
+	 @return	true if a frame finished.
+	 */
+	bool pollRenderAsync();
+
+	/**
+	 @brief	Gets the number of frames started by beginRenderAsync() that haven't finished.
+	
+	 @return	The number of frames in flight.
+	 */
+	int getFramesInFlight() { return openCLFramesInFlight; }
+
+	/**
+	 @brief	Gets the time the last render took.
+	
+	 @return	The time taken in microseconds.
+	 */
+	uint64_t getTimeTaken() { return timeTaken; }
+
+	/**
+	 @brief	Gets the per stage device timings of the last OpenCL render. With several devices the kernel time is
+		the slowest device's, the others are summed over every device.
+	
+	 @return	The profile, zeroed if the last render didn't use OpenCL.
+	 */
+	const OpenCLProfile& getOpenCLProfile() { return openCLProfile; }
+
+	/**
+	 @brief	Gets the pixels of the last render. After an OpenCL render on a device sharing memory with the host
+		these are the frame the device rendered into, so they are only valid until the next render is started.
+	
+	 @return	The pixels, packed RGBA8 (one byte per channel), null before the first render.
+	 */
+	unsigned char* getPixels() { return framePixels; }
+
+	/**
+	 @brief	Gets the width of the image.
+	
+	 @return	The width in pixels.
+	 */
+	int getWidth() { return width; }
+
+	/**
+	 @brief	Gets the height of the image.
+	
+	 @return	The height in pixels.
+	 */
+	int getHeight() { return height; }
+
+	/**
+	 @brief	Query if OpenCL was initialised and can be used.
+	
+	 @return	true if OpenCL is available.
+	 */
+	bool isOpenCLAvailable() { return openCLAvailable; }
+
+	/**
+	 @brief	Gets the name of the OpenCL device.
+	
+	 @return	The device name, empty if no device was found.
+	 */
+	std::string getOpenCLDeviceName();
+
+	/**
+	 @brief	Sets the work-group shape the OpenCL kernel is run with. The frame is dispatched as a 2D range
+		rounded up to a multiple of it, 0x0 leaves the shape to the driver.
+	
+	 @param	groupWidth 	Width of the work-group in pixels.
+	 @param	groupHeight	Height of the work-group in pixels.
+	
+	 @return	false if the device can't run work-groups that big or is being tuned, the size is left unchanged.
+	 */
+	bool setWorkGroupSize(int groupWidth, int groupHeight);
+
+	/**
+	 @brief	Gets the width of the OpenCL work-group.
+	
+	 @return	The width in pixels, 0 if the driver chooses.
+	 */
+	int getWorkGroupWidth() { return openCLAvailable ? openCLDevices[0]->getWorkGroupWidth() : 0; }
+
+	/**
+	 @brief	Gets the height of the OpenCL work-group.
+	
+	 @return	The height in pixels, 0 if the driver chooses.
+	 */
+	int getWorkGroupHeight() { return openCLAvailable ? openCLDevices[0]->getWorkGroupHeight() : 0; }
+
+	/**
+	 @brief	Times the kernel on the current scene with a range of work-group shapes built from the kernel's
+		preferred work-group size multiple, and keeps the fastest. Set a scene first.
+	
+	 @return	false if OpenCL isn't available or tuning is already running.
+	 */
+	bool tuneWorkGroupSize();
+
+	/**
+	 @brief	Starts tuneWorkGroupSize() so the caller isn't held up by the device, poll with pollTuneWorkGroupSize().
+		Only the kernel timing runs on a worker thread, the frames in flight are finished before it starts and
+		the shape found is applied by the poll. Until then beginRenderAsync() won't start a frame, and rendering
+		or changing the scene waits for the tuning.
+	
+	 @return	false if OpenCL isn't available or tuning is already running.
+	 */
+	bool beginTuneWorkGroupSize();
+
+	/**
+	 @brief	Checks if the tuning started by beginTuneWorkGroupSize() has finished, without blocking,
+		and applies the shape it found if so.
+	
+	 @param [out]	tuned	Set to the result of tuneWorkGroupSize() once finished.
+	
+	 @return	true if the tuning finished.
+	 */
+	bool pollTuneWorkGroupSize(bool& tuned);
+
+	/**
+	 @brief	Gets the number of threads the parallel CPU mode uses.
+	
+	 @return	The thread count.
+	 */
+	unsigned int getThreadCount() { return threadPool->getThreadCount(); }
+
+	/**
+	 @brief	Gets the display name of a mode.
+	
+	 @param	mode	The mode.
+	
+	 @return	The name e.g. "CPU Parallel".
+	 */
+	static std::string getModeName(Mode mode);
+
+	/**
+	 @brief	Query if a mode renders with OpenCL, in whole or in part.
+	
+	 @param	mode	The mode.
+	
+	 @return	true if the mode needs OpenCL.
+	 */
+	static bool isOpenCLMode(Mode mode) { return mode == OpenCL || mode == OpenCLMultiDevice || mode == Hybrid; }
+
+	/**
+	 @brief	Gets the command line name of a mode.
+	
+	 @param	mode	The mode.
+	
+	 @return	The name e.g. "cpu-parallel".
+	 */
+	static std::string getModeArgument(Mode mode);
+
+	/**
+	 @brief	Converts a command line mode name to a mode.
+	
+	 @param 			argument	The name (cpu, cpu-parallel, opencl, opencl-multi or hybrid).
+	 @param [in,out]	mode		The mode.
+	
+	 @return	false if the name isn't a mode.
+	 */
+	static bool parseModeArgument(std::string argument, Mode& mode);
+
+	/**
+	 @brief	Sets the precision the CPU ray tracers intersect rays at, OpenCL always uses single precision.
+	
+	 @param	precision	The precision, Single by default.
+	 */
+	void setPrecision(Precision precision) { cpuPrecision = precision; }
+
+	/**
+	 @brief	Gets the precision the CPU ray tracers intersect rays at.
+	
+	 @return	The precision.
+	 */
+	Precision getPrecision() { return cpuPrecision; }
+
+	/**
+	 @brief	Converts a command line precision name to a precision.
+	
+	 @param 			argument	The name (float or double).
+	 @param [in,out]	precision	The precision.
+	
+	 @return	false if the name isn't a precision.
+	 */
+	static bool parsePrecisionArgument(std::string argument, Precision& precision);
+
+	/**
+	 @brief	Turns the time taken and memory report logged after every render on or off, on by default.
+		Reading the memory report allocates, so it is turned off to check that rendering doesn't.
+	
+	 @param	logTimings	true to log.
+	 */
+	void setLogTimings(bool logTimings) { this->logTimings = logTimings; }
+
+	/**
+	 @brief	Encode PNG.
+	
+	 @param	filename 	Filename of the file.
+	 @param	imageData	The pixels, packed RGBA8.
+	 @param	width	 	The width.
+	 @param	height   	The height.
+
+	 @return	true if the file was written.
+	 */
+	static bool encodePNG(const char* filename, const unsigned char* imageData, unsigned width, unsigned height);
+
+private:
+
+	/** @brief	Checks the single ray and packet tracing paths against each other. */
+	friend class SelfTest;
+
+	/** @brief	The width of the image. */
+	int width;
+	/** @brief	The height of the image. */
+	int height;
+
+	/** @brief	The performance counter that measures the performance of the ray tracer. */
+	PerformanceCounter timer;
+	/** @brief	The previous value from the performance counter. */
+	uint64_t timeTaken;
+
+	/**
+	 @brief	Stops the timer and logs the time taken.
+	
+	 @param	modeName	Name of the mode that was timed.
+	 */
+	void stopTimer(std::string modeName);
+
+	/** @brief	The precision the CPU ray tracers intersect rays at. */
+	Precision cpuPrecision;
+
+	/** @brief	True to log the time taken and memory after every render. */
+	bool logTimings;
+
+	/**
+	 @brief	Logs the time taken and memory use.
+	
+	 @param	modeName	Name of the mode that was timed.
+	 */
+	void logTimeTaken(std::string modeName);
+
+	/** @brief	The array of pixels, packed RGBA8 (one byte per channel). */
+	std::vector<unsigned char> pixels;
+	/** @brief	The pixels of the last render, the pixel array or the host frame an OpenCL device rendered into. */
+	unsigned char* framePixels;
+	/** @brief	Number of pixels. */
+	int pixelCount;
+
+	/** @brief	Number of triangles per cube. */
+	static const int numOfTrianglesPerCube = 12;
+	/** @brief	Number of points in a triangle. */
+	static const int numOfPointsInTriangle = 3;
+
+	//Rays
+	/** @brief	The ray direction. */
+	glm::vec4 rayDir;
+
+	/**
+	 @brief	Gets the origin of the primary ray through a pixel. The rays are parallel so each one starts at its pixel,
+		the OpenCL kernel does the same from the work item's index.
+	
+	 @param	x	The x coordinate of the pixel.
+	 @param	y	The y coordinate of the pixel.
+	
+	 @return	The ray origin.
+	 */
+	glm::vec4 getRayOrigin(int x, int y) const { return glm::vec4((float)x, (float)y, 0.0f, 1.0f); }
+
+	//Scene Objects
+	/** @brief	The array of sphere origins. */
+	std::vector<glm::vec4> sphereOrigins;
+	/** @brief	The array of sphere radius. */
+	std::vector<float> sphereRadius;
+	/** @brief	List of colours of the spheres. */
+	std::vector<glm::vec4> sphereColours;
+
+	/** @brief	The array of cubes. */
+	std::vector<Cube> cubes;
+
+	/** @brief	The triangles of every cube with their transforms baked in, rebuilt on scene change. */
+	TriangleStore sceneTriangles;
+
+	/** @brief	The colour of each cube, rebuilt on scene change. */
+	std::vector<glm::vec4> cubeColours;
+
+	/** @brief	The bounding volume hierarchy over the cubes and spheres, rebuilt on scene change. */
+	BVH sceneBVH;
+
+	/** @brief	What the ray tracers read the scene through, points into the arrays above. */
+	SceneView sceneView;
+
+	//SceneCreation
+	/** @brief	Creates scene 1. */
+	void createScene1();
+	/** @brief	Creates scene 2. */
+	void createScene2();
+	/** @brief	Creates scene 3. */
+	void createScene3();
+
+	/**
+	 @brief	Adds randomly placed, sized and coloured spheres and cubes to the scene.
+	
+	 @param	sphereCount	Number of spheres.
+	 @param	cubeCount  	Number of cubes.
+	 @param	areaWidth  	The width of the area the objects are placed in.
+	 @param	areaHeight 	The height of the area the objects are placed in.
+	 */
+	void createRandomScene(int sphereCount, int cubeCount, float areaWidth, float areaHeight);
+
+	/** @brief	Removes every object from the scene. */
+	void clearScene();
+
+	/** @brief	Builds the BVH over the scene and marks the OpenCL copy out of date. */
+	void buildScene();
+
+	//Memory accounting
+	/** @brief	The bytes this ray tracer has counted against the scene subsystem. */
+	long long countedSceneBytes;
+	/** @brief	The bytes this ray tracer has counted against the frame buffer subsystem. */
+	long long countedFrameBufferBytes;
+
+	/** @brief	Recounts the scene and frame buffer memory and updates the MemoryCounter with the difference. */
+	void updateMemoryCounters();
+
+	//OpenCL
+	/** @brief	True if OpenCL was initialised, OpenCL renders are skipped if not. */
+	bool openCLAvailable;
+	/** @brief	Which OpenCL device to use, see the constructor. */
+	std::string openCLDeviceSelection;
+	/** @brief	How to split the OpenCL device into sub-devices, see the constructor. */
+	std::string openCLFission;
+	/** @brief	The selected OpenCL device, before any fission. */
+	cl_device_id openCLSelectedDeviceID;
+	/** @brief	The sub-devices the selected device was split into, empty if it is used whole. */
+	std::vector<cl_device_id> openCLSubDeviceIDs;
+	/** @brief	Every OpenCL device found, numbered as in the log. */
+	std::vector<cl_device_id> openCLDeviceIDs;
+	/** @brief	The kernel source. */
+	std::string openCLSource;
+	/** @brief	The options the kernel is built with. */
+	std::string openCLBuildOptions;
+	/** @brief	The devices in use, the selected device (or its sub-devices) first, then the rest once multi device mode is first used. */
+	std::vector<OpenCLDevice*> openCLDevices;
+	/** @brief	Number of devices at the start of openCLDevices that make up the selected device. */
+	size_t openCLSelectedDeviceCount;
+	/** @brief	True once every device has been set up for multi device mode. */
+	bool openCLMultiDeviceInitialised;
+	/** @brief	The share of the frame's rows each device renders, from its measured throughput. */
+	std::vector<float> openCLBandShares;
+
+	/** @brief	The stage timings of the last OpenCL render. */
+	OpenCLProfile openCLProfile;
+
+	/**
+	 @brief	Executes the ray tracer using OpenCL, splitting the frame into a band of rows per device.
+	
+	 @param	deviceCount	Number of devices to use, from the start of openCLDevices.
+	 */
+	void executeRayTracerOpenCL(size_t deviceCount);
+
+	/**
+	 @brief	Creates a device's frame buffers and uploads the scene if they are out of date.
+	
+	 @param [in,out]	device	The device.
+	 */
+	void prepareOpenCLDevice(OpenCLDevice* device);
+
+	/**
+	 @brief	Sets up every other device found for multi device mode, devices that fail are skipped.
+		The frame starts evenly split between them.
+	 */
+	void initOpenCLMultiDevice();
+
+	/**
+	 @brief	Splits rows between devices by their band shares. Every device gets at least one row
+		so its throughput can still be measured.
+	
+	 @param	deviceCount	Number of devices.
+	 @param	rowCount   	Number of rows to split, from the top of the frame.
+	
+	 @return	The number of rows for each device.
+	 */
+	std::vector<int> getOpenCLBandRows(size_t deviceCount, int rowCount);
+
+	/** @brief	A frame rendering into one of the devices' output buffers. */
+	struct OpenCLFrame
+	{
+		/** @brief	Number of devices rendering the frame, from the start of openCLDevices. */
+		size_t deviceCount;
+		/** @brief	The rows given to each device. */
+		std::vector<int> bandRows;
+		/** @brief	Times the frame from being started. */
+		PerformanceCounter timer;
+		/** @brief	When the frame was started, from PerformanceCounter::getTimestampNanoseconds(). */
+		uint64_t startTime;
+		/** @brief	Name of the mode rendering the frame. */
+		std::string modeName;
+	};
+
+	/** @brief	The frame for each output buffer. */
+	OpenCLFrame openCLFrames[OpenCLDevice::BUFFER_COUNT];
+	/** @brief	The output buffer the next frame renders into. */
+	int nextOpenCLFrame;
+	/** @brief	Number of frames started and not yet finished. */
+	int openCLFramesInFlight;
+
+	/**
+	 @brief	Gets the output buffer of the oldest frame in flight.
+	
+	 @return	The buffer index.
+	 */
+	int getOldestOpenCLFrame() { return (nextOpenCLFrame - openCLFramesInFlight + OpenCLDevice::BUFFER_COUNT) % OpenCLDevice::BUFFER_COUNT; }
+
+	/**
+	 @brief	Starts a frame in the next output buffer: uploads anything out of date, splits rows from the top of the frame
+		between devices and starts each rendering its band. Nothing is waited on.
+	
+	 @param	deviceCount	Number of devices, from the start of openCLDevices.
+	 @param	rowCount   	Number of rows to render.
+	 @param	modeName   	Name of the mode rendering the frame.
+	 */
+	void beginOpenCLFrame(size_t deviceCount, int rowCount, std::string modeName);
+
+	/**
+	 @brief	Query if every band of the oldest frame has been read back, without blocking.
+	
+	 @return	true if finishOpenCLFrame() won't have to wait.
+	 */
+	bool isOpenCLFrameReady();
+
+	/**
+	 @brief	Waits for the oldest frame if it isn't ready, copies it into the pixel array, gathers the profile
+		and rebalances the bands.
+	
+	 @return	The time from the frame being started to its last band being read back in nanoseconds, on the host's clock.
+	 */
+	uint64_t finishOpenCLFrame();
+
+	/** @brief	Waits for and finishes every frame in flight, including a hybrid frame's CPU rows, and any work-group tuning. */
+	void finishOpenCLFrames();
+
+	/**
+	 @brief	Copies the last frame into the pixel array if it is presented from the host frame of an output buffer,
+		as the device unmaps and writes over the host frame when the buffer is next rendered into.
+	
+	 @param	bufferIndex	The output buffer about to be rendered into.
+	 */
+	void copyPresentedHostFrame(int bufferIndex);
+
+	/** @brief	Finishes the frames in flight and gets the first device ready to be tuned on the current scene. */
+	void prepareTuneWorkGroupSize();
+
+	/**
+	 @brief	Waits for the tuning started by beginTuneWorkGroupSize() if it is running, and applies the shape it found
+		to every sub-device.
+	
+	 @return	false if no tuning was running, or the shape couldn't be applied.
+	 */
+	bool finishTuneWorkGroupSize();
+
+	/**
+	 @brief	Moves the band shares towards each device's throughput (rows per nanosecond of kernel time) in the last frame,
+		so the devices finish together.
+	
+	 @param	bandRows   	The rows each device rendered.
+	 @param	kernelTimes	The kernel time of each device in nanoseconds.
+	 */
+	void balanceOpenCLBands(const std::vector<int>& bandRows, const std::vector<uint64_t>& kernelTimes);
+
+	/**
+	 @brief	Moves a share of the frame part of the way towards the share measured in the last frame,
+		so one noisy frame doesn't throw the split off. Used by every load balancer.
+	
+	 @param	share		 	The current share.
+	 @param	measuredShare	The share that would have made everything finish together last frame.
+	
+	 @return	The new share.
+	 */
+	static float smoothShare(float share, float measuredShare);
+
+	/** @brief	Executes the ray tracer using CPU. */
+	void executeRayTracerCPU();
+
+	/** @brief	Executes the ray tracer using every CPU core, a tile at a time. */
+	void executeRayTracerCPUParallel();
+
+	/**
+	 @brief	Traces a range of rows using every CPU core, a tile at a time.
+	
+	 @param	firstRow	The first row.
+	 @param	endRow  	One past the last row.
+	 */
+	void traceRowsParallel(int firstRow, int endRow);
+
+	/**
+	 @brief	Starts tracing a range of rows on every CPU core without waiting, the thread pool's batch finishes when they are done.
+	
+	 @param	firstRow	The first row.
+	 @param	endRow  	One past the last row.
+	 */
+	void beginTraceRowsParallel(int firstRow, int endRow);
+
+	/**
+	 @brief	Traces one tile of the rows started by beginTraceRowsParallel(), run by the thread pool.
+	
+	 @param	rayTracer	The ray tracer.
+	 @param	tileIndex	Zero-based index of the tile.
+	 */
+	static void traceTile(void* rayTracer, int tileIndex);
+
+	/** @brief	The first row being traced by the thread pool. */
+	int tileFirstRow;
+	/** @brief	One past the last row being traced by the thread pool. */
+	int tileEndRow;
+	/** @brief	Number of tiles across the frame. */
+	int tilesX;
+
+	/**
+	 @brief	Executes the ray tracer with OpenCL rendering the top of the frame while every CPU core renders the rest,
+		then moves the split so both finish together next frame.
+	 */
+	void executeRayTracerHybrid();
+
+	/** @brief	Splits the frame by hybridOpenCLShare and starts OpenCL on the top and the thread pool on the rest. */
+	void beginHybridFrame();
+
+	/** @brief	Waits for both sides of the hybrid frame, logs their times and moves the split so both finish together next frame. */
+	void finishHybridFrame();
+
+	/**
+	 @brief	Gets the rows OpenCL renders in a hybrid frame. Both sides get at least a row so both can be measured.
+	
+	 @param	share   	OpenCL's share of the frame.
+	 @param	rowCount	Number of rows in the frame.
+	
+	 @return	The rows from the top of the frame, all of them if there is only one.
+	 */
+	static int getHybridOpenCLRows(float share, int rowCount);
+
+	/** @brief	The share of the frame's rows OpenCL renders in hybrid mode, from the last frame's throughputs. */
+	float hybridOpenCLShare;
+	/** @brief	True while a hybrid frame is in flight. */
+	bool hybridFrameInProgress;
+	/** @brief	The rows OpenCL renders in the hybrid frame in flight. */
+	int hybridOpenCLRows;
+
+	/** @brief	The first device's kernel timing running on a worker thread, not valid if none is. */
+	std::future<void> workGroupTuning;
+
+	/** @brief	Width and height of the tiles the parallel CPU ray tracer splits the frame into. */
+	const int tileSize = 32;
+
+	/** @brief	The worker threads used by the parallel CPU ray tracer. */
+	ThreadPool* threadPool;
+
+	//OpenCL Utility Functions
+	/**
+	 @brief	Loads compute shader from file.
+	
+	 @param	path	Full pathname of the file.
+	
+	 @return	The compute shader file contents.
+	 */
+	std::string loadComputeShaderFromFile(std::string path);
+
+	/**
+	 @brief	Finds every device on every OpenCL platform and logs their capabilities.
+	
+	 @return	The devices, numbered in the order they were logged.
+	 */
+	std::vector<cl_device_id> enumerateOpenCLDevices();
+
+	/**
+	 @brief	Logs the capabilities of a device that matter for tuning (compute units, memory, vector widths etc.).
+	
+	 @param	device	   	The device.
+	 @param	deviceIndex	The index of the device across every platform.
+	 */
+	void logOpenCLDeviceCapabilities(cl_device_id device, int deviceIndex);
+
+	/**
+	 @brief	Picks the device matching a selection.
+	
+	 @param	devices  	The devices from enumerateOpenCLDevices().
+	 @param	selection	The selection, see the constructor.
+	
+	 @return	The device, nullptr if none match.
+	 */
+	cl_device_id selectOpenCLDevice(const std::vector<cl_device_id>& devices, std::string selection);
+
+	/**
+	 @brief	Splits a CPU device into sub-devices with device fission.
+	
+	 @param	device 	The device.
+	 @param	fission	How to split it, see the constructor.
+	
+	 @return	The sub-devices, empty if the device is to be used whole.
+	 */
+	std::vector<cl_device_id> partitionOpenCLDevice(cl_device_id device, std::string fission);
+
+	/**
+	 @brief	Splits a device's compute units as evenly as possible between sub-devices.
+	
+	 @param	computeUnits  	Number of compute units on the device.
+	 @param	subDeviceCount	Number of sub-devices, at least 1.
+	
+	 @return	The compute units of each sub-device, adding up to computeUnits.
+	 */
+	static std::vector<cl_uint> splitComputeUnits(cl_uint computeUnits, cl_uint subDeviceCount);
+
+	/**
+	 @brief	Sets up a device for each ID and adds them to openCLDevices.
+	
+	 @param	deviceIDs	The devices.
+	
+	 @return	true if every device was set up, if not openCLDevices is left empty.
+	 */
+	bool initOpenCLDevices(const std::vector<cl_device_id>& deviceIDs);
+
+	/**
+	 @brief	OpenCL initialization.
+
+	 @return	false if OpenCL couldn't be set up.
+	 */
+	bool openCLInit();
+
+	//Ray Tracer CPU Functions
+	/**
+	 @brief	Checks the passed in ray collides with any of the shapes in the hierarchy.
+		Only reads the scene, so it is safe to call from any thread and never allocates.
+	
+	 @tparam	T	The precision the intersection tests run at, float or double.
+	
+	 @param	ray  	The ray.
+	 @param	scene	The scene.
+	
+	 @return	The Colour value for this pixel/ray. Black if no intersect.
+	 */
+	template <typename T>
+	static glm::vec4 collide(const Ray& ray, const SceneView& scene);
+
+	/**
+	 @brief	Checks a packet of rays against the shapes in the hierarchy, testing each triangle against the whole packet at once.
+		Gives the same result as calling collide<float>() on each ray.
+	
+	 @param 			packet 	The rays.
+	 @param 			scene  	The scene.
+	 @param [in,out]	colours	The Colour value for each ray in the packet. Black if no intersect.
+	 */
+	static void collidePacket(const RayPacket& packet, const SceneView& scene, glm::vec4* colours);
+
+	/**
+	 @brief	Gets the colour of the closest hit along a ray.
+	
+	 @param	scene				The scene.
+	 @param	closest				The distance to the closest hit.
+	 @param	closestPrimitive	The primitive hit, -1 if nothing was hit.
+	
+	 @return	The Colour value for the ray. Black if no intersect.
+	 */
+	static glm::vec4 shadeHit(const SceneView& scene, float closest, int closestPrimitive);
+
+	/**
+	 @brief	Traces a run of pixels along a row and writes them to the pixel array.
+		In single precision the rays are traced in packets, in double precision one at a time with collide().
+	
+	 @param	y	  	The row.
+	 @param	startX	The first column.
+	 @param	endX  	One past the last column.
+	 */
+	void traceRow(int y, int startX, int endX);
+};
\ No newline at end of file
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "glm/glm.hpp"
+
+#include "BVH.h"
+#include "TriangleStore.h"
+
+/**
+ @brief	A read-only view of everything needed to trace rays through a scene, pointing into arrays owned elsewhere.
+	Made once whenever the scene is built, so tracing never copies or allocates. The arrays it points into must not
+	change while it is in use.
+ */
+struct SceneView
+{
+	/** @brief	The BVH nodes, index 0 is the root. */
+	const BVHNode* nodes;
+	/** @brief	Number of BVH nodes, 0 for an empty scene. */
+	int nodeCount;
+	/** @brief	The primitive indices referenced by the BVH leaves. */
+	const int* primitiveIndices;
+	/** @brief	Number of primitive indices. */
+	int primitiveIndexCount;
+
+	/** @brief	The cube triangles, primitives below triangleCount. */
+	const TriangleStore* triangles;
+	/** @brief	Number of triangles, primitive indices at or above this are spheres. */
+	int triangleCount;
+	/** @brief	The colour of each cube, shared by its triangles. */
+	const glm::vec4* cubeColours;
+	/** @brief	Number of cubes. */
+	int cubeCount;
+
+	/** @brief	The sphere origins. */
+	const glm::vec4* sphereOrigins;
+	/** @brief	The sphere radius. */
+	const float* sphereRadius;
+	/** @brief	The sphere colours. */
+	const glm::vec4* sphereColours;
+	/** @brief	Number of spheres. */
+	int sphereCount;
+};
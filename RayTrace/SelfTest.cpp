@@ -0,0 +1,637 @@
+#include "SelfTest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include "PacketIntersect.h"
+#include "TriangleStore.h"
+#include "misc/Log.h"
+#include "misc/MemoryCounter.h"
+#include "misc/PerformanceCounter.h"
+#include "misc/Random.h"
+#include "misc/Utility.h"
+
+#ifdef SELF_TEST_COUNT_ALLOCATIONS
+//Every allocation the program makes is counted, the cost is one atomic increment each
+static std::atomic<long long> allocationCount(0);
+
+void* operator new(std::size_t size)
+{
+	allocationCount++;
+
+	void* memory = std::malloc(size == 0 ? 1 : size);
+	if (memory == nullptr)
+		throw std::bad_alloc();
+
+	return memory;
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	allocationCount++;
+	return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	std::free(memory);
+}
+#endif
+
+bool SelfTest::isRequested(int argc, char** argv)
+{
+	for (int argIndex = 1; argIndex < argc; argIndex++)
+	{
+		if (std::string(argv[argIndex]) == "--self-test")
+			return true;
+	}
+
+	return false;
+}
+
+int SelfTest::run(int, char**)
+{
+	//Scene 3 is random, seeded the same every run so a failure can be reproduced
+	Random::init(1);
+	PerformanceCounter::initSubsystem();
+	PacketIntersect::init();
+
+	RayTracer rayTracer(WIDTH, HEIGHT);
+
+	int failures = 0;
+	failures += checkPacketParity(rayTracer);
+	failures += checkPrecision(rayTracer);
+	failures += checkAllocations(rayTracer);
+	failures += checkMemoryCounter();
+	failures += checkProgramCacheKey();
+	failures += checkBandSplit(rayTracer);
+	failures += checkHybridSplit();
+	failures += checkHostFrames();
+	failures += checkTriangleStore();
+
+	if (failures > 0)
+	{
+		Log::logE("Self test failed, " + Utility::intToString(failures) + " check(s) failed");
+		return 1;
+	}
+
+	std::cout << "Self test passed" << std::endl;
+	return 0;
+}
+
+int SelfTest::countMismatches(const unsigned char* image, const unsigned char* reference, int pixelCount, int tolerance)
+{
+	int mismatches = 0;
+	for (int pixelIndex = 0; pixelIndex < pixelCount; pixelIndex++)
+	{
+		for (int channel = 0; channel < 4; channel++)
+		{
+			if (std::abs(image[(pixelIndex * 4) + channel] - reference[(pixelIndex * 4) + channel]) > tolerance)
+			{
+				mismatches++;
+				break;
+			}
+		}
+	}
+
+	return mismatches;
+}
+
+int SelfTest::checkPacketParity(RayTracer& rayTracer)
+{
+	int failures = 0;
+	std::vector<std::string> instructionSets = PacketIntersect::getSupportedInstructionSets();
+	std::vector<unsigned char> reference(WIDTH * HEIGHT * 4);
+
+	for (int scene = 1; scene <= 3; scene++)
+	{
+		rayTracer.setScene(scene);
+
+		//One ray at a time, in the same precision as the packets
+		Ray ray;
+		ray.direction = rayTracer.rayDir;
+		for (int y = 0; y < HEIGHT; y++)
+		{
+			for (int x = 0; x < WIDTH; x++)
+			{
+				int pixelIndex = (y * WIDTH) + x;
+				ray.origin = rayTracer.getRayOrigin(x, y);
+				glm::vec4 colour = RayTracer::collide<float>(ray, rayTracer.sceneView);
+
+				reference[(pixelIndex * 4)    ] = (unsigned char)(int)colour.r;
+				reference[(pixelIndex * 4) + 1] = (unsigned char)(int)colour.g;
+				reference[(pixelIndex * 4) + 2] = (unsigned char)(int)colour.b;
+				reference[(pixelIndex * 4) + 3] = (unsigned char)(int)colour.a;
+			}
+		}
+
+		for (auto& instructionSet : instructionSets)
+		{
+			PacketIntersect::setInstructionSet(instructionSet);
+			rayTracer.render(RayTracer::CPU);
+			const unsigned char* pixels = rayTracer.getPixels();
+
+			int mismatches = countMismatches(pixels, &reference[0], WIDTH * HEIGHT, 0);
+			bool passed = mismatches == 0;
+
+			std::cout << "Packet parity: scene " << scene << ", " << instructionSet << " - "
+				<< (passed ? "passed" : "FAILED") << ", " << mismatches << " pixels differ" << std::endl;
+
+			if (!passed)
+				failures++;
+		}
+	}
+
+	PacketIntersect::setInstructionSet(instructionSets.back());
+
+	return failures;
+}
+
+int SelfTest::checkPrecision(RayTracer& rayTracer)
+{
+	int failures = 0;
+	std::vector<unsigned char> singlePixels(WIDTH * HEIGHT * 4);
+
+	//Up to a thousandth of the frame may flip at edges, losing accuracy changes far more than that
+	const int maxMismatches = (WIDTH * HEIGHT) / 1000;
+
+	for (int scene = 1; scene <= 3; scene++)
+	{
+		rayTracer.setScene(scene);
+
+		rayTracer.setPrecision(RayTracer::Single);
+		rayTracer.render(RayTracer::CPU);
+		memcpy(&singlePixels[0], rayTracer.getPixels(), singlePixels.size());
+
+		rayTracer.setPrecision(RayTracer::Double);
+		rayTracer.render(RayTracer::CPU);
+
+		int roundedPixels = countMismatches(&singlePixels[0], rayTracer.getPixels(), WIDTH * HEIGHT, 0);
+		int mismatches = countMismatches(&singlePixels[0], rayTracer.getPixels(), WIDTH * HEIGHT, 1);
+		bool passed = mismatches <= maxMismatches;
+
+		std::cout << "Precision: scene " << scene << " - " << (passed ? "passed" : "FAILED") << ", " << mismatches
+			<< " pixels differ (" << roundedPixels << " including rounding)" << std::endl;
+
+		if (!passed)
+			failures++;
+	}
+
+	rayTracer.setPrecision(RayTracer::Single);
+
+	return failures;
+}
+
+int SelfTest::checkAllocations(RayTracer& rayTracer)
+{
+#ifdef SELF_TEST_COUNT_ALLOCATIONS
+	int failures = 0;
+
+	//The memory report is built in strings
+	rayTracer.setLogTimings(false);
+
+	for (int scene = 1; scene <= 3; scene++)
+	{
+		rayTracer.setScene(scene);
+
+		//The first renders size the pixel array and anything else kept between frames
+		rayTracer.render(RayTracer::CPU);
+		rayTracer.render(RayTracer::CPUParallel);
+
+		long long allocationsBefore = allocationCount;
+		rayTracer.render(RayTracer::CPU);
+		rayTracer.render(RayTracer::CPUParallel);
+		long long allocations = allocationCount - allocationsBefore;
+
+		std::cout << "Allocations: scene " << scene << " - "
+			<< (allocations == 0 ? "passed" : "FAILED, " + Utility::intToString((int)allocations) + " while rendering") << std::endl;
+
+		if (allocations > 0)
+			failures++;
+	}
+
+	rayTracer.setLogTimings(true);
+
+	return failures;
+#else
+	(void)rayTracer;
+	std::cout << "Allocations: skipped, build with SELF_TEST_COUNT_ALLOCATIONS defined to count them" << std::endl;
+	return 0;
+#endif
+}
+
+int SelfTest::checkMemoryCounter()
+{
+	int failures = 0;
+
+	//Trimmed from a real status file, values are in kB with tabs and padding between the name and value
+	const std::string status =
+		"Name:\tRayTrace\n"
+		"VmPeak:\t  318464 kB\n"
+		"VmSize:\t  318460 kB\n"
+		"VmHWM:\t   42312 kB\n"
+		"VmRSS:\t   40960 kB\n"
+		"Threads:\t9\n";
+
+	struct Field
+	{
+		const char* name;
+		long long expectedBytes;
+	};
+	const Field fields[] =
+	{
+		{ "VmSize", 318460LL * 1024 },
+		{ "VmHWM", 42312LL * 1024 },
+		{ "VmRSS", 40960LL * 1024 },
+		{ "VmSwap", 0 }
+	};
+
+	for (const Field& field : fields)
+	{
+		long long bytes = MemoryCounter::parseProcStatusField(status, std::string(field.name) + ":");
+		bool passed = bytes == field.expectedBytes;
+
+		std::cout << "Memory counter: " << field.name << " - " << (passed ? "passed" : "FAILED") << ", read " << bytes << " bytes" << std::endl;
+
+		if (!passed)
+			failures++;
+	}
+
+	long long residentBytes = MemoryCounter::getResidentMemory();
+	long long peakResidentBytes = MemoryCounter::getPeakResidentMemory();
+	bool passed = residentBytes > 0 && peakResidentBytes >= residentBytes;
+
+	std::cout << "Memory counter: this process - " << (passed ? "passed" : "FAILED") << ", " << residentBytes
+		<< " bytes resident, " << peakResidentBytes << " at peak" << std::endl;
+
+	if (!passed)
+		failures++;
+
+	return failures;
+}
+
+int SelfTest::checkProgramCacheKey()
+{
+	int failures = 0;
+
+	const std::string platformName = "Platform";
+	const std::string deviceName = "Device";
+	const std::string driverVersion = "1.0";
+	const std::string source = "__kernel void rayTracer() {}";
+	const std::string buildOptions = "-D STRIDE=8";
+
+	std::string key = OpenCLDevice::getProgramCacheKey(platformName, deviceName, driverVersion, source, buildOptions);
+	std::string fileName = OpenCLDevice::getProgramCacheFileName(platformName, deviceName, driverVersion);
+
+	struct Change
+	{
+		const char* name;
+		bool keyChanges;
+		std::string changedKey;
+		bool fileNameChanges;
+		std::string changedFileName;
+	};
+	const Change changes[] =
+	{
+		{ "nothing", false, OpenCLDevice::getProgramCacheKey(platformName, deviceName, driverVersion, source, buildOptions),
+			false, OpenCLDevice::getProgramCacheFileName(platformName, deviceName, driverVersion) },
+		{ "platform", true, OpenCLDevice::getProgramCacheKey("Other Platform", deviceName, driverVersion, source, buildOptions),
+			true, OpenCLDevice::getProgramCacheFileName("Other Platform", deviceName, driverVersion) },
+		{ "device", true, OpenCLDevice::getProgramCacheKey(platformName, "Other Device", driverVersion, source, buildOptions),
+			true, OpenCLDevice::getProgramCacheFileName(platformName, "Other Device", driverVersion) },
+		{ "driver", true, OpenCLDevice::getProgramCacheKey(platformName, deviceName, "1.1", source, buildOptions),
+			true, OpenCLDevice::getProgramCacheFileName(platformName, deviceName, "1.1") },
+		{ "source", true, OpenCLDevice::getProgramCacheKey(platformName, deviceName, driverVersion, source + " ", buildOptions),
+			false, fileName },
+		{ "build options", true, OpenCLDevice::getProgramCacheKey(platformName, deviceName, driverVersion, source, "-D STRIDE=16"),
+			false, fileName }
+	};
+
+	for (const Change& change : changes)
+	{
+		bool keyChanged = change.changedKey != key;
+		bool fileNameChanged = change.changedFileName != fileName;
+		bool passed = keyChanged == change.keyChanges && fileNameChanged == change.fileNameChanges;
+
+		std::cout << "Program cache: changing " << change.name << " - " << (passed ? "passed" : "FAILED") << ", key "
+			<< (keyChanged ? "changed" : "unchanged") << ", file " << (fileNameChanged ? "changed" : "unchanged") << std::endl;
+
+		if (!passed)
+			failures++;
+	}
+
+	return failures;
+}
+
+int SelfTest::checkBandSplit(RayTracer& rayTracer)
+{
+	int failures = 0;
+
+	//Compute units, the remainder going to the first sub-devices. Fission is refused for more sub-devices than units
+	const cl_uint computeUnitSplits[][2] = { { 8, 3 }, { 4, 4 }, { 7, 2 }, { 16, 1 }, { 5, 5 } };
+	for (auto& split : computeUnitSplits)
+	{
+		std::vector<cl_uint> counts = RayTracer::splitComputeUnits(split[0], split[1]);
+
+		cl_uint total = 0;
+		cl_uint smallest = counts.empty() ? 0 : counts[0];
+		cl_uint largest = smallest;
+		for (cl_uint count : counts)
+		{
+			total += count;
+			smallest = std::min(smallest, count);
+			largest = std::max(largest, count);
+		}
+
+		bool passed = counts.size() == split[1] && total == split[0] && smallest >= 1 && largest - smallest <= 1 && counts[0] == largest;
+
+		std::cout << "Band split: " << split[0] << " compute units into " << split[1] << " - " << (passed ? "passed" : "FAILED") << ",";
+		for (cl_uint count : counts)
+		{
+			std::cout << " " << count;
+		}
+		std::cout << std::endl;
+
+		if (!passed)
+			failures++;
+	}
+
+	std::vector<float> bandShares = rayTracer.openCLBandShares;
+
+	//Rows, including shares that round to nothing and frames with fewer rows than devices
+	struct RowSplit
+	{
+		std::vector<float> shares;
+		int rowCount;
+	};
+	const RowSplit rowSplits[] =
+	{
+		{ { 1.0f }, HEIGHT },
+		{ { 0.5f, 0.5f }, HEIGHT },
+		{ { 0.3f, 0.3f, 0.4f }, HEIGHT },
+		{ { 1.0f, 0.0f, 0.0f }, HEIGHT },
+		{ { 0.0f, 0.0f, 1.0f }, HEIGHT },
+		{ { 0.0001f, 0.9999f }, HEIGHT },
+		{ { 0.5f, 0.5f }, 1 },
+		{ { 0.3f, 0.3f, 0.4f }, 2 },
+		{ { 0.5f, 0.5f }, 0 }
+	};
+
+	for (const RowSplit& rowSplit : rowSplits)
+	{
+		rayTracer.openCLBandShares = rowSplit.shares;
+		std::vector<int> bandRows = rayTracer.getOpenCLBandRows(rowSplit.shares.size(), rowSplit.rowCount);
+
+		//Every device has a row to be measured by whenever there are enough to go round
+		int total = 0;
+		bool passed = bandRows.size() == rowSplit.shares.size();
+		for (int rows : bandRows)
+		{
+			total += rows;
+			if (rows < 0 || (rows == 0 && rowSplit.rowCount >= (int)bandRows.size()))
+				passed = false;
+		}
+		passed = passed && total == rowSplit.rowCount;
+
+		std::cout << "Band split: " << rowSplit.rowCount << " rows into " << rowSplit.shares.size() << " - " << (passed ? "passed" : "FAILED") << ",";
+		for (int rows : bandRows)
+		{
+			std::cout << " " << rows;
+		}
+		std::cout << std::endl;
+
+		if (!passed)
+			failures++;
+	}
+
+	//Balancing, the second device rendered as many rows in half the time so it should gain share, and without a time
+	// or rows for every device there is nothing to compare so the shares stay put
+	struct Balance
+	{
+		const char* name;
+		std::vector<int> bandRows;
+		std::vector<uint64_t> kernelTimes;
+		bool sharesChange;
+	};
+	const Balance balances[] =
+	{
+		{ "faster second device", { 240, 240 }, { 2000000, 1000000 }, true },
+		{ "missing kernel time", { 240, 240 }, { 2000000, 0 }, false },
+		{ "empty band", { 480, 0 }, { 2000000, 1000000 }, false }
+	};
+
+	for (const Balance& balance : balances)
+	{
+		rayTracer.openCLBandShares.assign(2, 0.5f);
+		rayTracer.balanceOpenCLBands(balance.bandRows, balance.kernelTimes);
+		const std::vector<float>& shares = rayTracer.openCLBandShares;
+
+		bool sharesAddUp = std::abs(shares[0] + shares[1] - 1.0f) < 0.0001f;
+		bool passed = sharesAddUp && (balance.sharesChange ? (shares[1] > 0.5f && shares[1] < 2.0f / 3.0f) : shares[1] == 0.5f);
+
+		std::cout << "Band split: balancing " << balance.name << " - " << (passed ? "passed" : "FAILED") << ", shares "
+			<< shares[0] << " " << shares[1] << std::endl;
+
+		if (!passed)
+			failures++;
+	}
+
+	rayTracer.openCLBandShares = bandShares;
+
+	return failures;
+}
+
+int SelfTest::checkHybridSplit()
+{
+	int failures = 0;
+
+	//Shares the balancing could reach, including ones rounding to no rows at either end
+	struct RowSplit
+	{
+		float share;
+		int rowCount;
+		int expectedRows;
+	};
+	const RowSplit rowSplits[] =
+	{
+		{ 0.5f, HEIGHT, HEIGHT / 2 },
+		{ 0.0f, HEIGHT, 1 },
+		{ 0.0001f, HEIGHT, 1 },
+		{ 1.0f, HEIGHT, HEIGHT - 1 },
+		{ 0.9999f, HEIGHT, HEIGHT - 1 },
+		{ 0.5f, 2, 1 },
+		{ 0.0f, 1, 1 },
+		{ 0.5f, 0, 0 }
+	};
+
+	for (const RowSplit& rowSplit : rowSplits)
+	{
+		int rows = RayTracer::getHybridOpenCLRows(rowSplit.share, rowSplit.rowCount);
+		bool passed = rows == rowSplit.expectedRows;
+
+		std::cout << "Hybrid split: share " << rowSplit.share << " of " << rowSplit.rowCount << " rows - " << (passed ? "passed" : "FAILED")
+			<< ", OpenCL " << rows << ", CPU " << (rowSplit.rowCount - rows) << std::endl;
+
+		if (!passed)
+			failures++;
+	}
+
+	//Smoothing moves part of the way, never past what was measured, and stays put once they agree
+	const float smoothings[][2] = { { 0.5f, 0.9f }, { 0.5f, 0.1f }, { 0.25f, 0.25f }, { 0.0f, 1.0f } };
+	for (auto& smoothing : smoothings)
+	{
+		float share = RayTracer::smoothShare(smoothing[0], smoothing[1]);
+
+		bool passed = (smoothing[0] == smoothing[1]) ? share == smoothing[0]
+			: (share > std::min(smoothing[0], smoothing[1]) && share < std::max(smoothing[0], smoothing[1]));
+
+		std::cout << "Hybrid split: smoothing " << smoothing[0] << " towards " << smoothing[1] << " - " << (passed ? "passed" : "FAILED")
+			<< ", " << share << std::endl;
+
+		if (!passed)
+			failures++;
+	}
+
+	return failures;
+}
+
+int SelfTest::checkHostFrames()
+{
+	int failures = 0;
+
+	const size_t cacheLineSize = 64;
+	const size_t frameSizes[] = { 1, 64, 65, 4096, WIDTH * HEIGHT * 4, 641 * 479 * 4 };
+
+	for (size_t frameBytes : frameSizes)
+	{
+		size_t hostFrameSize = OpenCLDevice::getHostFrameSize(frameBytes);
+		unsigned char* hostFrame = OpenCLDevice::allocateHostFrame(hostFrameSize);
+
+		bool passed = hostFrame != nullptr && hostFrameSize % cacheLineSize == 0 && hostFrameSize >= frameBytes
+			&& hostFrameSize - frameBytes < cacheLineSize && (uintptr_t)hostFrame % OpenCLDevice::HOST_FRAME_ALIGNMENT == 0;
+
+		//The whole rounded size belongs to the frame, the buffer wrapping it is created that big
+		if (hostFrame != nullptr)
+			memset(hostFrame, 0, hostFrameSize);
+
+		std::cout << "Host frames: " << frameBytes << " bytes - " << (passed ? "passed" : "FAILED") << ", " << hostFrameSize
+			<< " bytes at " << ((uintptr_t)hostFrame % OpenCLDevice::HOST_FRAME_ALIGNMENT) << " past a page" << std::endl;
+
+		OpenCLDevice::freeHostFrame(hostFrame);
+
+		if (!passed)
+			failures++;
+	}
+
+	return failures;
+}
+
+int SelfTest::checkTriangleStore()
+{
+	int failures = 0;
+
+	//12 triangles a cube, so these cover strides with and without padding
+	const int cubeCounts[] = { 0, 1, 2, 3, 5 };
+
+	for (int cubeCount : cubeCounts)
+	{
+		std::vector<Cube> cubes;
+		for (int cubeIndex = 0; cubeIndex < cubeCount; cubeIndex++)
+		{
+			cubes.push_back(Cube(glm::vec4(255.0f)));
+			cubes.back().translate(glm::vec3(cubeIndex * 10.0f, cubeIndex * 5.0f, 100.0f));
+		}
+
+		TriangleStore triangleStore;
+		triangleStore.build(cubes);
+
+		int count = triangleStore.getCount();
+		int stride = triangleStore.getStride();
+
+		bool passed = count == cubeCount * 12 && stride % TriangleStore::STRIDE_MULTIPLE == 0 && stride >= count
+			&& stride - count < TriangleStore::STRIDE_MULTIPLE
+			&& triangleStore.getDataSize() == (size_t)stride * TriangleStore::ComponentCount * sizeof(float);
+
+		for (int component = 0; component < TriangleStore::ComponentCount && stride > 0; component++)
+		{
+			const float* componentData = triangleStore.getComponent((TriangleStore::Component)component);
+			if ((uintptr_t)componentData % TriangleStore::ALIGNMENT != 0)
+				passed = false;
+
+			for (int padding = count; padding < stride; padding++)
+			{
+				if (componentData[padding] != 0.0f)
+					passed = false;
+			}
+		}
+
+		int triangle = 0;
+		for (const Cube& cube : cubes)
+		{
+			const std::vector<glm::vec4>& vertices = cube.getTriangles();
+			for (size_t vertexIndex = 0; vertexIndex + 2 < vertices.size(); vertexIndex += 3, triangle++)
+			{
+				float vertex0[3];
+				float edge1[3];
+				float edge2[3];
+				triangleStore.getTriangle<float>(triangle, vertex0, edge1, edge2);
+
+				for (int axis = 0; axis < 3; axis++)
+				{
+					if (vertex0[axis] != vertices[vertexIndex][axis]
+						|| edge1[axis] != vertices[vertexIndex + 1][axis] - vertices[vertexIndex][axis]
+						|| edge2[axis] != vertices[vertexIndex + 2][axis] - vertices[vertexIndex][axis])
+						passed = false;
+				}
+			}
+		}
+
+		std::cout << "Triangle store: " << cubeCount << " cubes - " << (passed ? "passed" : "FAILED") << ", "
+			<< count << " triangles, stride " << stride << std::endl;
+
+		if (!passed)
+			failures++;
+	}
+
+	return failures;
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "RayTracer.h"
+
+/**
+@brief	Checks the CPU ray tracers against themselves from the command line, no window or OpenCL needed.
+	Usage: RayTrace --self-test
+	Every packet instruction set the CPU supports has to give the same image as tracing one ray at a time,
+	single precision has to agree with the double precision reference to within rounding, and once warmed up the CPU ray tracers must render without allocating. The memory counter's parsing
+	is checked against known text, and the OpenCL program cache against changes that must invalidate it.
+	How devices and frames are split between OpenCL devices and the CPU is checked without needing a device,
+	as is the layout of the host frames zero-copy devices render into and of the triangle store.
+	Counting allocations replaces operator new for the whole program, so it is only built in with
+	SELF_TEST_COUNT_ALLOCATIONS defined, otherwise that check is skipped.
+	Returns a non-zero exit code if any check fails, so it can be run from a build script.
+*/
+class SelfTest
+{
+public:
+
+	/**
+	 @brief	Query if the command line asks for the self test.
+	
+	 @param	argc	The number of command-line arguments.
+	 @param	argv	The command-line arguments.
+	
+	 @return	true if --self-test was passed.
+	 */
+	static bool isRequested(int argc, char** argv);
+
+	/**
+	 @brief	Runs every check and logs the results.
+	
+	 @param	argc	The number of command-line arguments.
+	 @param	argv	The command-line arguments.
+	
+	 @return	The exit code, 0 if every check passed.
+	 */
+	static int run(int argc, char** argv);
+
+private:
+
+	/** @brief	Width of the test renders, the size the built in scenes are laid out for. */
+	static const int WIDTH = 640;
+	/** @brief	Height of the test renders. */
+	static const int HEIGHT = 480;
+
+	/**
+	 @brief	Counts the pixels where any channel differs between two images by more than a tolerance.
+	
+	 @param	image	 	The image.
+	 @param	reference	The image to compare against.
+	 @param	pixelCount	Number of pixels in each.
+	 @param	tolerance 	The most a channel may differ by and still match.
+	
+	 @return	The number of pixels that differ.
+	 */
+	static int countMismatches(const unsigned char* image, const unsigned char* reference, int pixelCount, int tolerance);
+
+	/**
+	 @brief	Renders scenes 1 to 3 with every supported packet instruction set and compares each pixel with
+		collide<float>(), the single ray path.
+	
+	 @param [in,out]	rayTracer	The ray tracer, left on the widest instruction set.
+	
+	 @return	The number of scene and instruction set pairs that didn't match.
+	 */
+	static int checkPacketParity(RayTracer& rayTracer);
+
+	/**
+	 @brief	Renders scenes 1 to 3 with CPU at single and double precision and compares them. Shading may round
+		a step differently and a few rays grazing an edge may hit in one precision and miss in the other,
+		anything more means single precision has lost accuracy.
+	
+	 @param [in,out]	rayTracer	The ray tracer, left at single precision.
+	
+	 @return	The number of scenes that didn't agree.
+	 */
+	static int checkPrecision(RayTracer& rayTracer);
+
+	/**
+	 @brief	Renders scenes 1 to 3 once with CPU and CPU Parallel to warm up, then again counting every allocation
+		made through operator new.
+	
+	 @param [in,out]	rayTracer	The ray tracer.
+	
+	 @return	The number of scenes that allocated while rendering, 0 if allocations aren't counted in this build.
+	 */
+	static int checkAllocations(RayTracer& rayTracer);
+
+	/**
+	 @brief	Parses a /proc/self/status snapshot with known values, and checks the process's own resident memory
+		is counted.
+	
+	 @return	The number of fields read wrong.
+	 */
+	static int checkMemoryCounter();
+
+	/**
+	 @brief	Checks a cached OpenCL program is only reused when the platform, device, driver, kernel source and
+		build options all match, and that each platform, device and driver gets its own cache file.
+	
+	 @return	The number of changes the key or file name didn't follow.
+	 */
+	static int checkProgramCacheKey();
+
+	/**
+	 @brief	Checks a device's compute units and a frame's rows are split between devices without losing or
+		inventing any, that every device keeps a row to be measured by, and that the band shares move towards
+		the faster device.
+	
+	 @param [in,out]	rayTracer	The ray tracer, its band shares are restored afterwards.
+	
+	 @return	The number of splits that were wrong.
+	 */
+	static int checkBandSplit(RayTracer& rayTracer);
+
+	/**
+	 @brief	Checks the hybrid split leaves both OpenCL and the CPU a row whatever the share, and that shares are
+		smoothed part of the way towards what was measured.
+	
+	 @return	The number of splits that were wrong.
+	 */
+	static int checkHybridSplit();
+
+	/**
+	 @brief	Checks host frames are rounded up to whole cache lines and allocated page aligned, as runtimes
+		only render into host memory in place when both hold.
+	
+	 @return	The number of frame sizes that were wrong.
+	 */
+	static int checkHostFrames();
+
+	/**
+	 @brief	Builds triangle stores for a range of cube counts and checks every component array is padded to
+		an aligned stride, the padding is zeroed and each triangle reads back as its cube's vertex and edges.
+	
+	 @return	The number of stores laid out wrong.
+	 */
+	static int checkTriangleStore();
+};
@@ -1,6 +1,7 @@
 #include "Texture.h"
 
 #include <assert.h>
+#include <cstring>
 
 #include "misc/Log.h"
 
@@ -16,6 +17,30 @@ Texture::Texture(SDL_Surface* surface, SDL_Renderer* renderer, bool keepSurface)
 	texture = nullptr;
 	load(surface, renderer);
 }
+
+Texture::Texture(int width, int height, SDL_Renderer* renderer)
+	: keepSurface(false)
+{
+	surface = nullptr;
+	currentRenderer = renderer;
+
+	//Byte order R, G, B, A whatever the endianness of the machine
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+	Uint32 format = SDL_PIXELFORMAT_RGBA8888;
+#else
+	Uint32 format = SDL_PIXELFORMAT_ABGR8888;
+#endif
+
+	texture = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STREAMING, width, height);
+	if (texture == nullptr)
+	{
+		Log::logE("Can't create streaming texture " + std::string(SDL_GetError()));
+	}
+
+	dimensions.x = (float)width;
+	dimensions.y = (float)height;
+}
+
 Texture::~Texture()
 {
 	if (texture != nullptr)
@@ -192,4 +217,34 @@ void Texture::setColourTint(SDL_Colour c)
 	{
 		Log::logW("SDL_SetTextureColorMod failed in setColourTint");
 	}
+}
+
+bool Texture::update(const unsigned char* pixels, int pitch)
+{
+	void* lockedPixels = nullptr;
+	int lockedPitch = 0;
+
+	if (SDL_LockTexture(texture, NULL, &lockedPixels, &lockedPitch) != 0)
+	{
+		Log::logW("SDL_LockTexture failed in update " + std::string(SDL_GetError()));
+		return false;
+	}
+
+	//The locked rows may be padded, so copy a row at a time unless the pitches match
+	int height = (int)dimensions.y;
+	if (lockedPitch == pitch)
+	{
+		memcpy(lockedPixels, pixels, (size_t)pitch * height);
+	}
+	else
+	{
+		int rowBytes = (pitch < lockedPitch) ? pitch : lockedPitch;
+		for (int y = 0; y < height; y++)
+		{
+			memcpy((unsigned char*)lockedPixels + (y * lockedPitch), pixels + (y * pitch), rowBytes);
+		}
+	}
+
+	SDL_UnlockTexture(texture);
+	return true;
 }
\ No newline at end of file
@@ -31,6 +31,14 @@ public:
 	*/
 	Texture(SDL_Surface* surface, SDL_Renderer* renderer, bool keepSurface = false);
 
+	/**
+	@brief Create a blank streaming Texture, its pixels are written with update()
+	@param width Width in pixels
+	@param height Height in pixels
+	@param renderer SDL_Renderer
+	*/
+	Texture(int width, int height, SDL_Renderer* renderer);
+
 	~Texture();
 
 	/**
@@ -91,6 +99,14 @@ public:
 	*/
 	void setColourTint(SDL_Colour colour);
 
+	/**
+	@brief Replace the pixels of a streaming texture (see the width/height constructor)
+	@param pixels Packed RGBA8 pixels, one byte per channel in that order
+	@param pitch Bytes per row of pixels
+	@return bool - Whether it was successful
+	*/
+	bool update(const unsigned char* pixels, int pitch);
+
 	/**
 	@brief Get the renderer used for this sprite
 	@return SDL_Renderer* - The renderer used in the creation of this Texture
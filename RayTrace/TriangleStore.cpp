@@ -0,0 +1,42 @@
+#include "TriangleStore.h"
+
+TriangleStore::TriangleStore()
+	: count(0), stride(0)
+{
+
+}
+
+void TriangleStore::build(const std::vector<Cube>& cubes)
+{
+	count = 0;
+	for (auto& cube : cubes)
+	{
+		count += (int)cube.getTriangles().size() / 3;
+	}
+
+	stride = ((count + STRIDE_MULTIPLE - 1) / STRIDE_MULTIPLE) * STRIDE_MULTIPLE;
+	data.assign((size_t)stride * ComponentCount, 0.0f);
+
+	int triangle = 0;
+	for (auto& cube : cubes)
+	{
+		const std::vector<glm::vec4>& vertices = cube.getTriangles();
+
+		for (size_t vertexIndex = 0; vertexIndex + 2 < vertices.size(); vertexIndex += 3, triangle++)
+		{
+			glm::vec3 vertex0 = glm::vec3(vertices[vertexIndex]);
+			glm::vec3 edge1 = glm::vec3(vertices[vertexIndex + 1]) - vertex0;
+			glm::vec3 edge2 = glm::vec3(vertices[vertexIndex + 2]) - vertex0;
+
+			data[Vertex0X * stride + triangle] = vertex0.x;
+			data[Vertex0Y * stride + triangle] = vertex0.y;
+			data[Vertex0Z * stride + triangle] = vertex0.z;
+			data[Edge1X * stride + triangle] = edge1.x;
+			data[Edge1Y * stride + triangle] = edge1.y;
+			data[Edge1Z * stride + triangle] = edge1.z;
+			data[Edge2X * stride + triangle] = edge2.x;
+			data[Edge2Y * stride + triangle] = edge2.y;
+			data[Edge2Z * stride + triangle] = edge2.z;
+		}
+	}
+}
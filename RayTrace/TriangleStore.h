@@ -0,0 +1,132 @@
+#pragma once
+
+#include "glm/glm.hpp"
+#include <vector>
+
+#include "Cube.h"
+#include "misc/AlignedAllocator.h"
+
+/**
+ @brief	Every cube triangle of a scene stored as structure of arrays, ready for the Moller-Trumbore test.
+	Each triangle is kept as its first vertex and the two edges leaving it, so the edges are worked out once
+	when the scene is built rather than for every ray. The nine components are separate arrays in one
+	allocation, each starting on a 32 byte boundary, and the same allocation is uploaded to OpenCL as is.
+	Triangles are in cube order, 12 per cube, matching the primitive numbering of the BVH.
+ */
+class TriangleStore
+{
+public:
+
+	/** @brief	Alignment of each component array in bytes (one AVX register). */
+	static const int ALIGNMENT = 32;
+
+	/**
+	 @brief	Component arrays are padded to a multiple of this many floats so each stays aligned.
+		Passed to the OpenCL kernel as a build option so it can find the arrays.
+	 */
+	static const int STRIDE_MULTIPLE = ALIGNMENT / sizeof(float);
+
+	/** @brief	The component arrays, in the order they are stored. */
+	enum Component
+	{
+		Vertex0X,
+		Vertex0Y,
+		Vertex0Z,
+		Edge1X,
+		Edge1Y,
+		Edge1Z,
+		Edge2X,
+		Edge2Y,
+		Edge2Z,
+		ComponentCount
+	};
+
+	/** @brief	Default constructor. */
+	TriangleStore();
+
+	/**
+	 @brief	Bakes the triangles of every cube into the store, replacing any previous ones.
+
+	 @param	cubes	The cubes, already transformed.
+	 */
+	void build(const std::vector<Cube>& cubes);
+
+	/**
+	 @brief	Gets the number of triangles.
+
+	 @return	The triangle count.
+	 */
+	int getCount() const { return count; }
+
+	/**
+	 @brief	Gets the number of floats between the start of one component array and the next.
+
+	 @return	The stride, a multiple of STRIDE_MULTIPLE.
+	 */
+	int getStride() const { return stride; }
+
+	/**
+	 @brief	Gets one component of every triangle.
+
+	 @param	component	The component.
+
+	 @return	The component array, aligned to ALIGNMENT bytes.
+	 */
+	const float* getComponent(Component component) const { return data.data() + component * stride; }
+
+	/**
+	 @brief	Gets every component array, for uploading in one go.
+
+	 @return	ComponentCount arrays of getStride() floats.
+	 */
+	const float* getData() const { return data.data(); }
+
+	/**
+	 @brief	Gets the size of getData().
+
+	 @return	The size in bytes.
+	 */
+	size_t getDataSize() const { return data.size() * sizeof(float); }
+
+	/**
+	 @brief	Gets a triangle in the precision the intersection test runs at.
+
+	 @param 	   	triangle	Zero-based index of the triangle.
+	 @param [out]	vertex0 	The first vertex.
+	 @param [out]	edge1   	The edge from the first vertex to the second.
+	 @param [out]	edge2   	The edge from the first vertex to the third.
+	 */
+	template <typename T>
+	void getTriangle(int triangle, T vertex0[3], T edge1[3], T edge2[3]) const
+	{
+		const float* triangleData = &data[triangle];
+
+		vertex0[0] = (T)triangleData[Vertex0X * stride];
+		vertex0[1] = (T)triangleData[Vertex0Y * stride];
+		vertex0[2] = (T)triangleData[Vertex0Z * stride];
+		edge1[0] = (T)triangleData[Edge1X * stride];
+		edge1[1] = (T)triangleData[Edge1Y * stride];
+		edge1[2] = (T)triangleData[Edge1Z * stride];
+		edge2[0] = (T)triangleData[Edge2X * stride];
+		edge2[1] = (T)triangleData[Edge2Y * stride];
+		edge2[2] = (T)triangleData[Edge2Z * stride];
+	}
+
+	/**
+	 @brief	Gets the memory held by the store.
+
+	 @return	The memory in bytes.
+	 */
+	size_t getMemoryUsage() const { return data.capacity() * sizeof(float); }
+
+private:
+
+	/** @brief	Number of triangles. */
+	int count;
+
+	/** @brief	Floats between the start of each component array. */
+	int stride;
+
+	/** @brief	The component arrays back to back, padding past the last triangle is zeroed. */
+	std::vector<float, AlignedAllocator<float, ALIGNMENT>> data;
+};
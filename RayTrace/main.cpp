@@ -9,6 +9,10 @@
 #include "states/StateManager.h"
 #include "states/MainState.h"
 #include "misc/PerformanceCounter.h"
+#include "PacketIntersect.h"
+#include "HeadlessRenderer.h"
+#include "Benchmark.h"
+#include "SelfTest.h"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -21,8 +25,24 @@ extern "C"
 }
 #endif
 
-int main(int, char**)
+int main(int argc, char** argv)
 {
+	//Render from the command line without a window
+	if (HeadlessRenderer::isRequested(argc, argv))
+	{
+		return HeadlessRenderer::run(argc, argv);
+	}
+
+	if (Benchmark::isRequested(argc, argv))
+	{
+		return Benchmark::run(argc, argv);
+	}
+
+	if (SelfTest::isRequested(argc, argv))
+	{
+		return SelfTest::run(argc, argv);
+	}
+
 	//Get Settings Dir
 	std::string settingsPath = SDL_GetPrefPath("RH", "GCP A2");
 	settingsPath += "settings.xml";
@@ -41,6 +61,7 @@ int main(int, char**)
 	Random::init();
 	DeltaTime::init();
 	PerformanceCounter::initSubsystem();
+	PacketIntersect::init();
 
 
 	SDL_Renderer* renderer = platform->getRenderer();
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+/**
+@brief	A std::vector allocator that aligns its storage, so arrays can be loaded straight into SIMD registers
+	or wrapped by an OpenCL buffer without a copy.
+
+@tparam	T		 	The element type.
+@tparam	Alignment	The alignment in bytes, a power of two no smaller than sizeof(void*).
+*/
+template <typename T, size_t Alignment>
+class AlignedAllocator
+{
+public:
+
+	typedef T value_type;
+
+	template <typename U>
+	struct rebind
+	{
+		typedef AlignedAllocator<U, Alignment> other;
+	};
+
+	AlignedAllocator() {}
+
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	/**
+	 @brief	Allocates aligned storage for a number of elements.
+
+	 @exception	std::bad_alloc	Thrown when the memory can't be allocated.
+
+	 @param	count	Number of elements.
+
+	 @return	The storage.
+	 */
+	T* allocate(size_t count)
+	{
+		void* memory = allocateBytes(count * sizeof(T));
+		if (memory == nullptr)
+			throw std::bad_alloc();
+
+		return (T*)memory;
+	}
+
+	/**
+	 @brief	Frees storage from allocate().
+
+	 @param [in,out]	memory	The storage.
+	 */
+	void deallocate(T* memory, size_t)
+	{
+		freeBytes(memory);
+	}
+
+	/**
+	 @brief	Allocates aligned memory.
+
+	 @param	size	The size in bytes.
+
+	 @return	The memory, null if it could not be allocated.
+	 */
+	static void* allocateBytes(size_t size)
+	{
+#ifdef _WIN32
+		return _aligned_malloc(size, Alignment);
+#else
+		void* memory = nullptr;
+		if (posix_memalign(&memory, Alignment, size) != 0)
+			return nullptr;
+
+		return memory;
+#endif
+	}
+
+	/**
+	 @brief	Frees memory from allocateBytes().
+
+	 @param [in,out]	memory	The memory, may be null.
+	 */
+	static void freeBytes(void* memory)
+	{
+#ifdef _WIN32
+		_aligned_free(memory);
+#else
+		free(memory);
+#endif
+	}
+};
+
+template <typename T, typename U, size_t Alignment>
+bool operator==(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) { return true; }
+
+template <typename T, typename U, size_t Alignment>
+bool operator!=(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) { return false; }
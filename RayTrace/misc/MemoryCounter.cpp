@@ -1,8 +1,19 @@
 #include "MemoryCounter.h"
 
+#include "Utility.h"
 
+#include <sstream>
+
+#ifdef _WIN32
 #include <windows.h>
 #include <psapi.h>
+#else
+#include <fstream>
+#endif
+
+std::atomic<long long> MemoryCounter::subsystemBytes[SubsystemCount];
+
+#ifdef _WIN32
 
 long long MemoryCounter::getMemoryUsage()
 {
@@ -10,3 +21,106 @@ long long MemoryCounter::getMemoryUsage()
 	GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
 	return (pmc.PagefileUsage);
 }
+
+long long MemoryCounter::getResidentMemory()
+{
+	PROCESS_MEMORY_COUNTERS pmc;
+	GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+	return (pmc.WorkingSetSize);
+}
+
+long long MemoryCounter::getPeakResidentMemory()
+{
+	PROCESS_MEMORY_COUNTERS pmc;
+	GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+	return (pmc.PeakWorkingSetSize);
+}
+
+#else
+
+long long MemoryCounter::readProcStatusField(const std::string& field)
+{
+	std::ifstream statusFile("/proc/self/status");
+	std::stringstream status;
+	status << statusFile.rdbuf();
+
+	return parseProcStatusField(status.str(), field);
+}
+
+long long MemoryCounter::getMemoryUsage()
+{
+	return readProcStatusField("VmSize:");
+}
+
+long long MemoryCounter::getResidentMemory()
+{
+	return readProcStatusField("VmRSS:");
+}
+
+long long MemoryCounter::getPeakResidentMemory()
+{
+	return readProcStatusField("VmHWM:");
+}
+
+#endif
+
+long long MemoryCounter::parseProcStatusField(const std::string& status, const std::string& field)
+{
+	std::istringstream lines(status);
+	std::string line;
+
+	while (std::getline(lines, line))
+	{
+		if (line.compare(0, field.size(), field) == 0)
+		{
+			//Values are in kB e.g. "VmRSS:	   40960 kB"
+			std::istringstream value(line.substr(field.size()));
+			long long kilobytes = 0;
+			value >> kilobytes;
+			return kilobytes * 1024;
+		}
+	}
+
+	return 0;
+}
+
+void MemoryCounter::addSubsystemBytes(Subsystem subsystem, long long bytes)
+{
+	subsystemBytes[subsystem] += bytes;
+}
+
+long long MemoryCounter::getSubsystemBytes(Subsystem subsystem)
+{
+	return subsystemBytes[subsystem];
+}
+
+std::string MemoryCounter::getSubsystemName(Subsystem subsystem)
+{
+	switch (subsystem)
+	{
+	case Scene:
+		return "Scene";
+	case FrameBuffer:
+		return "Frame Buffer";
+	case DeviceBuffers:
+		return "Device Buffers";
+	default:
+		return "Unknown";
+	}
+}
+
+std::string MemoryCounter::getReport()
+{
+	const float bytesPerMB = 1024.0f * 1024.0f;
+
+	std::string report = "RSS: " + Utility::floatToString(getResidentMemory() / bytesPerMB, 1) + "MB"
+		+ " (Peak " + Utility::floatToString(getPeakResidentMemory() / bytesPerMB, 1) + "MB)";
+
+	for (int subsystem = 0; subsystem < SubsystemCount; subsystem++)
+	{
+		report += ", " + getSubsystemName((Subsystem)subsystem) + ": "
+			+ Utility::floatToString(getSubsystemBytes((Subsystem)subsystem) / bytesPerMB, 2) + "MB";
+	}
+
+	return report;
+}
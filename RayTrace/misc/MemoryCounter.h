@@ -1,14 +1,103 @@
 #pragma once
 
-/** @brief	A class that contains methods to get the current memory usage of the program. */
+#include <string>
+#include <atomic>
+
+/**
+@brief	A class that contains methods to get the current memory usage of the program,
+	and keeps a count of the bytes held by each subsystem of the ray tracer.
+*/
 class MemoryCounter
 {
 public:
 
+	/** @brief	The subsystems memory is counted for. */
+	enum Subsystem
+	{
+		Scene,			///< Scene objects and the BVH built over them
+		FrameBuffer,	///< The host pixel array, and the host frames zero-copy OpenCL devices render into
+		DeviceBuffers,	///< OpenCL buffers
+		SubsystemCount
+	};
+
 	/**
 	 @brief	Gets current physical + virtual memory usage.
 	
-	 @return	The memory usage in bytes.
+	 @return	The memory usage in bytes, 0 if it couldn't be read.
 	 */
 	static long long getMemoryUsage();
-};
\ No newline at end of file
+
+	/**
+	 @brief	Gets the resident set size, the physical memory the process is using.
+	
+	 @return	The resident memory in bytes, 0 if it couldn't be read.
+	 */
+	static long long getResidentMemory();
+
+	/**
+	 @brief	Gets the highest the resident set size has been since the process started.
+	
+	 @return	The peak resident memory in bytes, 0 if it couldn't be read.
+	 */
+	static long long getPeakResidentMemory();
+
+	/**
+	 @brief	Adds to (or with a negative amount removes from) the bytes counted for a subsystem.
+	
+	 @param	subsystem	The subsystem.
+	 @param	bytes	 	The change in bytes.
+	 */
+	static void addSubsystemBytes(Subsystem subsystem, long long bytes);
+
+	/**
+	 @brief	Gets the bytes counted for a subsystem.
+	
+	 @param	subsystem	The subsystem.
+	
+	 @return	The bytes.
+	 */
+	static long long getSubsystemBytes(Subsystem subsystem);
+
+	/**
+	 @brief	Gets the display name of a subsystem.
+	
+	 @param	subsystem	The subsystem.
+	
+	 @return	The name e.g. "Frame Buffer".
+	 */
+	static std::string getSubsystemName(Subsystem subsystem);
+
+	/**
+	 @brief	Gets a one line summary of the resident memory and every subsystem.
+	
+	 @return	The summary e.g. "RSS: 40.1MB (Peak 42.3MB), Scene: 0.2MB, ...".
+	 */
+	static std::string getReport();
+
+private:
+
+	/** @brief	Checks the status parsing against known text. */
+	friend class SelfTest;
+
+	/**
+	 @brief	Reads a field from the text of /proc/self/status.
+	
+	 @param	status	The status text.
+	 @param	field 	The field name including the colon e.g. "VmRSS:".
+	
+	 @return	The value in bytes, 0 if the field wasn't found.
+	 */
+	static long long parseProcStatusField(const std::string& status, const std::string& field);
+
+	/**
+	 @brief	Reads a field from /proc/self/status, not available on Windows.
+	
+	 @param	field	The field name including the colon e.g. "VmRSS:".
+	
+	 @return	The value in bytes, 0 if the field wasn't found.
+	 */
+	static long long readProcStatusField(const std::string& field);
+
+	/** @brief	The bytes counted for each subsystem. */
+	static std::atomic<long long> subsystemBytes[SubsystemCount];
+};
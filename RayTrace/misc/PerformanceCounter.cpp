@@ -1,28 +1,29 @@
 #include "PerformanceCounter.h"
 
 #include "Log.h"
-
-#ifdef _MSC_VER
-LARGE_INTEGER PerformanceCounter::frequency;
-#endif // _MSC_VER
+#include "Utility.h"
 
 void PerformanceCounter::initSubsystem()
 {
-#ifdef _MSC_VER
-	if (QueryPerformanceFrequency(&frequency) == 0)
+	//The standard only promises steady_clock is monotonic, so log how fine it really is
+	double tickNanoseconds = (double)Clock::period::num * 1000000000.0 / (double)Clock::period::den;
+
+	if (tickNanoseconds > 1000.0)
 	{
-		//Not huge problem just means that the performance counter module will not work.
-		Log::logW("Could not initalize Performance Counter Subsystem: " + GetLastError());
-		frequency.QuadPart = 0;
+		//Not huge problem just means timings will be coarse
+		Log::logW("Performance Counter resolution is only " + Utility::floatToString((float)tickNanoseconds) + "ns");
 	}
-#endif // _MSC_VER
-	
-	Log::logI("Performance Counter Subsystem Initialized");
+
+	Log::logI("Performance Counter Subsystem Initialized (" + Utility::floatToString((float)tickNanoseconds) + "ns resolution)");
 }
 
+uint64_t PerformanceCounter::getTimestampNanoseconds()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
 
 PerformanceCounter::PerformanceCounter()
-	: running(false)
+	: running(false), accumulated(0)
 {
 
 }
@@ -31,33 +32,53 @@ void PerformanceCounter::startCounter()
 {
 	if (!running)
 	{
-		//This only fails if the function is unavailable on this system so I dont call it on stop
-		// as they are the same function and stop can't be called until start.
-		if (QueryPerformanceCounter(&startTime) == 0)
-		{
-			Log::logW("Performance Counter could not start: " + GetLastError());
-			return;
-		}
+		startTime = Clock::now();
+		lapTime = startTime;
 		running = true;
 	}
 }
 
 uint64_t PerformanceCounter::stopCounter()
+{
+	//Convert to microseconds
+	return stopCounterNanoseconds() / 1000;
+}
+
+uint64_t PerformanceCounter::stopCounterNanoseconds()
 {
 	if (running)
 	{
-		QueryPerformanceCounter(&endTime);
+		Clock::time_point endTime = Clock::now();
 		running = false;
 
-		LARGE_INTEGER timeElapsed;
-		timeElapsed.QuadPart = endTime.QuadPart - startTime.QuadPart;
+		uint64_t elapsed = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count();
+		accumulated += elapsed;
+
+		return elapsed;
+	}
+
+	return 0;
+}
+
+uint64_t PerformanceCounter::getSplitNanoseconds()
+{
+	if (running)
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - startTime).count();
+	}
+
+	return 0;
+}
 
-		//Convert to microseconds (This is done first to prevent loss of precision)
-		timeElapsed.QuadPart *= 1000000;
-		//Convert to ticks per second
-		timeElapsed.QuadPart /= frequency.QuadPart;
+uint64_t PerformanceCounter::lap()
+{
+	if (running)
+	{
+		Clock::time_point now = Clock::now();
+		uint64_t lapElapsed = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now - lapTime).count();
+		lapTime = now;
 
-		return timeElapsed.QuadPart;
+		return lapElapsed;
 	}
 
 	return 0;
@@ -1,18 +1,17 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
 
-//If Visual Studio
-#ifdef _MSC_VER
-#include <Windows.h>
-#endif // _MSC_VER
-
 /**
-@brief	A class that provides high accuracy timers for profiling a program 
-	I've decided to use Window's performance counters as C++ chrono is not
-	fully working in < VS 2015. and internally chrono just calls these functions anyway.
+@brief	A class that provides high accuracy timers for profiling a program.
+	Built on std::chrono::steady_clock, which is QueryPerformanceCounter on Windows
+	and clock_gettime(CLOCK_MONOTONIC) on Linux, so it never jumps with the wall clock.
 
-@todo Implement other platforms using std::chrono
+	Besides a plain start/stop it supports:
+	- Splits: the time since the counter started, without stopping it.
+	- Laps: the time since the previous lap, for timing consecutive stages (e.g. upload, kernel, readback).
+	- Accumulating: every start/stop interval is added to a running total until it is reset.
 */
 class PerformanceCounter
 {
@@ -21,6 +20,13 @@ public:
 	/** @brief	Initializes the static elements of this class */
 	static void initSubsystem();
 
+	/**
+	 @brief	Gets the current time on the counters' clock, for comparing when things happened on different threads.
+	
+	 @return	The time in nanoseconds since an arbitrary point.
+	 */
+	static uint64_t getTimestampNanoseconds();
+
 	/** @brief	Default constructor. */
 	PerformanceCounter();
 
@@ -34,23 +40,58 @@ public:
 	 */
 	uint64_t stopCounter();
 
+	/**
+	 @brief	Stops the counter and returns the elapsed time in nanoseconds.
+	
+	 @return	An uint64_t containing elapsed time in nanoseconds.
+	 */
+	uint64_t stopCounterNanoseconds();
+
+	/**
+	 @brief	Gets the time since the counter started without stopping it.
+	
+	 @return	The elapsed time in nanoseconds, 0 if not running.
+	 */
+	uint64_t getSplitNanoseconds();
+
+	/**
+	 @brief	Gets the time since the previous lap (or the start) and begins a new lap.
+	
+	 @return	The lap time in nanoseconds, 0 if not running.
+	 */
+	uint64_t lap();
+
+	/**
+	 @brief	Gets the total of every start/stop interval since the last reset.
+	
+	 @return	The accumulated time in nanoseconds.
+	 */
+	uint64_t getAccumulatedNanoseconds() { return accumulated; }
+
+	/** @brief	Resets the accumulated time to 0. */
+	void resetAccumulated() { accumulated = 0; }
+
+	/**
+	 @brief	Query if the counter is running.
+	
+	 @return	true if running.
+	 */
+	bool isRunning() { return running; }
+
 private:
 
+	/** @brief	The clock used for every counter. */
+	typedef std::chrono::steady_clock Clock;
+
 	/** @brief	Is the counter running. */
 	bool running;
 
-#ifdef _MSC_VER
-
 	/** @brief	The time the counter started. */
-	LARGE_INTEGER startTime;
+	Clock::time_point startTime;
 
-	/** @brief	The time the count ended. */
-	LARGE_INTEGER endTime;
+	/** @brief	The time the current lap started. */
+	Clock::time_point lapTime;
 
-	/** 
-	@brief	The frequency of the counter.
-	Consistent value after system boot
-	 */
-	static LARGE_INTEGER frequency;
-#endif // _MSC_VER
-};
\ No newline at end of file
+	/** @brief	The accumulated time in nanoseconds. */
+	uint64_t accumulated;
+};
@@ -0,0 +1,165 @@
+#include "ThreadPool.h"
+
+#include "Log.h"
+#include "PerformanceCounter.h"
+#include "Utility.h"
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+	: taskFunction(nullptr), taskContext(nullptr), remainingTasks(0), batchDone(true), batchStartTime(0), batchFinishTime(0),
+	batchNumber(0), stopping(false)
+{
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency();
+
+		//hardware_concurrency is allowed to return 0 when it can't tell
+		if (threadCount == 0)
+			threadCount = 1;
+	}
+
+	for (unsigned int workerIndex = 0; workerIndex < threadCount; workerIndex++)
+	{
+		queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+		queues.back()->front = 0;
+		queues.back()->back = 0;
+	}
+
+	for (unsigned int workerIndex = 0; workerIndex < threadCount; workerIndex++)
+	{
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this, workerIndex));
+	}
+
+	Log::logI("Thread Pool started with " + Utility::intToString((int)threadCount) + " threads");
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(batchMutex);
+		stopping = true;
+	}
+	batchStarted.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::beginBatch(int taskCount, TaskFunction function, void* context)
+{
+	batchStartTime = PerformanceCounter::getTimestampNanoseconds();
+
+	if (taskCount <= 0)
+	{
+		std::lock_guard<std::mutex> lock(batchMutex);
+		batchDone = true;
+		batchFinishTime = batchStartTime;
+		return;
+	}
+
+	taskFunction = function;
+	taskContext = context;
+	remainingTasks = taskCount;
+
+	//Cleared before any task is queued, a worker still looking for work could otherwise finish the batch first
+	{
+		std::lock_guard<std::mutex> lock(batchMutex);
+		batchDone = false;
+	}
+
+	//Hand each worker a contiguous run of tasks, neighbouring tiles tend to cost about the same
+	unsigned int workerCount = (unsigned int)queues.size();
+	for (unsigned int workerIndex = 0; workerIndex < workerCount; workerIndex++)
+	{
+		std::lock_guard<std::mutex> lock(queues[workerIndex]->mutex);
+		queues[workerIndex]->front = (int)(((long long)taskCount * workerIndex) / workerCount);
+		queues[workerIndex]->back = (int)(((long long)taskCount * (workerIndex + 1)) / workerCount);
+	}
+
+	std::lock_guard<std::mutex> lock(batchMutex);
+	batchNumber++;
+	batchStarted.notify_all();
+}
+
+bool ThreadPool::isBatchFinished()
+{
+	std::lock_guard<std::mutex> lock(batchMutex);
+	return batchDone;
+}
+
+void ThreadPool::waitForBatch()
+{
+	std::unique_lock<std::mutex> lock(batchMutex);
+	batchFinished.wait(lock, [this]() { return batchDone; });
+}
+
+uint64_t ThreadPool::getBatchNanoseconds()
+{
+	std::lock_guard<std::mutex> lock(batchMutex);
+	return batchDone ? batchFinishTime - batchStartTime : 0;
+}
+
+void ThreadPool::workerLoop(unsigned int workerIndex)
+{
+	unsigned int lastBatch = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(batchMutex);
+			batchStarted.wait(lock, [this, lastBatch]() { return stopping || batchNumber != lastBatch; });
+
+			if (stopping)
+				return;
+
+			lastBatch = batchNumber;
+		}
+
+		int task = 0;
+		while (takeTask(workerIndex, task))
+		{
+			taskFunction(taskContext, task);
+
+			if (--remainingTasks == 0)
+			{
+				//Lock so the notify can't slip in between waitForBatch checking the flag and sleeping
+				std::lock_guard<std::mutex> lock(batchMutex);
+				batchFinishTime = PerformanceCounter::getTimestampNanoseconds();
+				batchDone = true;
+				batchFinished.notify_all();
+			}
+		}
+	}
+}
+
+bool ThreadPool::takeTask(unsigned int workerIndex, int& task)
+{
+	//Own queue first
+	{
+		WorkQueue& ownQueue = *queues[workerIndex];
+		std::lock_guard<std::mutex> lock(ownQueue.mutex);
+
+		if (ownQueue.front < ownQueue.back)
+		{
+			task = ownQueue.front++;
+			return true;
+		}
+	}
+
+	//Steal from the back of the next worker along that still has work
+	unsigned int workerCount = (unsigned int)queues.size();
+	for (unsigned int offset = 1; offset < workerCount; offset++)
+	{
+		WorkQueue& victim = *queues[(workerIndex + offset) % workerCount];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+
+		if (victim.front < victim.back)
+		{
+			task = --victim.back;
+			return true;
+		}
+	}
+
+	return false;
+}
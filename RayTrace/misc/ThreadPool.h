@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+@brief	A fixed size pool of worker threads that runs batches of indexed tasks.
+	Each worker has its own queue of tasks, once it runs dry it steals from the back of the
+	other workers' queues so uneven tasks (e.g. busy and empty tiles) still balance out.
+*/
+class ThreadPool
+{
+public:
+
+	/**
+	 @brief	Constructor.
+
+	 @param	threadCount	Number of worker threads, 0 to use one per hardware thread.
+	 */
+	ThreadPool(unsigned int threadCount = 0);
+
+	/** @brief	Destructor, waits for the workers to exit. */
+	~ThreadPool();
+
+	/**
+	 @brief	Runs task(0) to task(taskCount - 1) across the workers and blocks until all have finished.
+		The task is called through a pointer rather than copied into a std::function, so nothing is allocated.
+
+	 @param	taskCount	Number of tasks.
+	 @param	task	 	The task, called with the task index. Must be safe to call from several threads at once.
+	 */
+	template <typename Task>
+	void parallelFor(int taskCount, const Task& task)
+	{
+		beginBatch(taskCount, [](void* context, int taskIndex) { (*(const Task*)context)(taskIndex); }, (void*)&task);
+		waitForBatch();
+	}
+
+	/** @brief	A task run by beginBatch(), called with the context it was given and the task index. */
+	typedef void(*TaskFunction)(void* context, int taskIndex);
+
+	/**
+	 @brief	Starts running function(context, 0) to function(context, taskCount - 1) across the workers without waiting,
+		so the caller can do something else (e.g. wait on OpenCL) in the meantime. Only one batch can run at once.
+
+	 @param	taskCount	Number of tasks.
+	 @param	function 	The task. Must be safe to call from several threads at once.
+	 @param	context  	Passed to the task, must stay valid until the batch has finished.
+	 */
+	void beginBatch(int taskCount, TaskFunction function, void* context);
+
+	/**
+	 @brief	Query if every task of the last batch has finished, without blocking.
+
+	 @return	true if the batch has finished.
+	 */
+	bool isBatchFinished();
+
+	/** @brief	Blocks until every task of the last batch has finished. */
+	void waitForBatch();
+
+	/**
+	 @brief	Gets how long the last batch took, from beginBatch() to its last task finishing rather than to it being
+		waited on, so it can be compared with other work that ran alongside it.
+
+	 @return	The time in nanoseconds, 0 if the batch hasn't finished.
+	 */
+	uint64_t getBatchNanoseconds();
+
+	/**
+	 @brief	Gets the number of worker threads.
+
+	 @return	The thread count.
+	 */
+	unsigned int getThreadCount() const { return (unsigned int)workers.size(); }
+
+private:
+
+	/** @brief	A worker's queue of task indices, a contiguous range so starting a batch allocates nothing. */
+	struct WorkQueue
+	{
+		/** @brief	Guards the range. */
+		std::mutex mutex;
+		/** @brief	The next task, the owner takes from the front. */
+		int front;
+		/** @brief	One past the last task, thieves take from the back. */
+		int back;
+	};
+
+	/** @brief	The worker threads. */
+	std::vector<std::thread> workers;
+
+	/** @brief	One queue per worker. */
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+
+	/** @brief	The task of the current batch. */
+	TaskFunction taskFunction;
+
+	/** @brief	The context passed to the task of the current batch. */
+	void* taskContext;
+
+	/** @brief	Number of tasks in the current batch that have not finished yet. */
+	std::atomic<int> remainingTasks;
+
+	/** @brief	Set once the last task of the batch finishes, guarded by batchMutex. */
+	bool batchDone;
+
+	/** @brief	When the current batch started, in nanoseconds. */
+	uint64_t batchStartTime;
+
+	/** @brief	When the last task of the batch finished, in nanoseconds, guarded by batchMutex. */
+	uint64_t batchFinishTime;
+
+	/** @brief	Incremented every batch so sleeping workers know there is new work. */
+	unsigned int batchNumber;
+
+	/** @brief	Set to make the workers exit. */
+	bool stopping;
+
+	/** @brief	Guards batchNumber, stopping, batchDone and batchFinishTime. */
+	std::mutex batchMutex;
+
+	/** @brief	Signalled when a batch starts or the pool is stopping. */
+	std::condition_variable batchStarted;
+
+	/** @brief	Signalled when the last task of a batch finishes. */
+	std::condition_variable batchFinished;
+
+	/**
+	 @brief	The loop each worker thread runs.
+
+	 @param	workerIndex	Zero-based index of the worker.
+	 */
+	void workerLoop(unsigned int workerIndex);
+
+	/**
+	 @brief	Takes a task from the worker's own queue, or steals one from another worker.
+
+	 @param 			workerIndex	Zero-based index of the worker.
+	 @param [in,out]	task	   	The task index taken.
+
+	 @return	false if every queue is empty.
+	 */
+	bool takeTask(unsigned int workerIndex, int& task);
+};
@@ -46,6 +46,23 @@ std::string Utility::floatToString(float num, unsigned int precision)
 	return result;
 }
 
+std::string Utility::hashString(const std::string& str)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (unsigned char character : str)
+	{
+		hash ^= character;
+		hash *= 1099511628211ULL;
+	}
+
+	std::stringstream stream;
+	stream << std::hex;
+	stream.width(16);
+	stream.fill('0');
+	stream << hash;
+	return stream.str();
+}
+
 std::string Utility::vec2ToString(Vec2 num)
 {
 	std::stringstream stream;
@@ -64,6 +64,15 @@ namespace Utility
 	*/
 	std::string floatToString(float num, unsigned int precision);
 
+	/**
+	@brief Hashes a string (64 bit FNV-1a), stable between runs and platforms so it can be saved to disk.
+
+	@param str - String to hash.
+
+	@return std::string - The hash as 16 hex digits.
+	*/
+	std::string hashString(const std::string& str);
+
 	/**
 	 @brief Converts a Vector 2 to a string.
 
@@ -0,0 +1,292 @@
+//Include guard rather than #pragma once, this is also the start of the OpenCL program
+#ifndef INTERSECT_H
+#define INTERSECT_H
+
+/*
+ The ray/primitive intersection tests, BVH traversal steps and shading shared by the CPU ray tracers and the OpenCL kernel.
+ Written in the subset of C++ and OpenCL C both compile, the host puts it in front of rayTracer.cl.
+ In C++ the primitive tests are inline templates instantiated for float, the default, and double, a reference to
+ validate float against. OpenCL C has no templates so the kernel gets the float version.
+ The BVH is stored in float so its traversal steps are float only. Everything takes private memory,
+ OpenCL 1.2 can't pass a pointer to global memory where a private one is expected.
+*/
+
+#ifdef __OPENCL_VERSION__
+typedef float Real;
+#define INTERSECT_FUNCTION
+#define INTERSECT_FLOAT_FUNCTION
+#define INTERSECT_SQRT sqrt
+#define INTERSECT_FLT_MAX FLT_MAX
+#else
+#include <cfloat>
+#include <cmath>
+#define INTERSECT_FUNCTION template <typename Real> inline
+#define INTERSECT_FLOAT_FUNCTION inline
+#define INTERSECT_SQRT std::sqrt
+#define INTERSECT_FLT_MAX FLT_MAX
+#endif
+
+//Macros
+// Ref: http://cs.lth.se/tomas_akenine-moller
+#define INTERSECT_EPSILON 0.000001
+#define INTERSECT_CROSS(dest,v1,v2) \
+          dest[0]=v1[1]*v2[2]-v1[2]*v2[1]; \
+          dest[1]=v1[2]*v2[0]-v1[0]*v2[2]; \
+          dest[2]=v1[0]*v2[1]-v1[1]*v2[0];
+#define INTERSECT_DOT(v1,v2) (v1[0]*v2[0]+v1[1]*v2[1]+v1[2]*v2[2])
+#define INTERSECT_SUB(dest,v1,v2) \
+          dest[0]=v1[0]-v2[0]; \
+          dest[1]=v1[1]-v2[1]; \
+          dest[2]=v1[2]-v2[2];
+
+#ifndef __OPENCL_VERSION__
+namespace Intersect
+{
+#endif
+
+/**
+ @brief	Intersect triangle.
+	Ref: http://cs.lth.se/tomas_akenine-moller
+
+ @param 	   	orig 	The ray origin.
+ @param 	   	dir  	The ray direction.
+ @param 	   	vert0	Triangle Point 1.
+ @param 	   	edge1	The edge from point 1 to point 2.
+ @param 	   	edge2	The edge from point 1 to point 3.
+ @param [out]	t	 	The distance along the ray to the hit.
+ @param [out]	u	 	The first barycentric coordinate of the hit.
+ @param [out]	v	 	The second barycentric coordinate of the hit.
+
+ @return	1 if intersecting or 0 if not.
+ */
+INTERSECT_FUNCTION
+int intersectTriangle(const Real orig[3], const Real dir[3],
+	const Real vert0[3], const Real edge1[3], const Real edge2[3],
+	Real *t, Real *u, Real *v)
+{
+	Real tvec[3], pvec[3], qvec[3];
+	Real det, inv_det;
+
+	/* the two edges sharing vert0 are worked out when the scene is built */
+
+	/* begin calculating determinant - also used to calculate U parameter */
+	INTERSECT_CROSS(pvec, dir, edge2);
+
+	/* if determinant is near zero, ray lies in plane of triangle */
+	det = INTERSECT_DOT(edge1, pvec);
+
+	if (det > -(Real)INTERSECT_EPSILON && det < (Real)INTERSECT_EPSILON)
+		return 0;
+	inv_det = (Real)1 / det;
+
+	/* calculate distance from vert0 to ray origin */
+	INTERSECT_SUB(tvec, orig, vert0);
+
+	/* calculate U parameter and test bounds */
+	*u = INTERSECT_DOT(tvec, pvec) * inv_det;
+	if (*u < (Real)0 || *u > (Real)1)
+		return 0;
+
+	/* prepare to test V parameter */
+	INTERSECT_CROSS(qvec, tvec, edge1);
+
+	/* calculate V parameter and test bounds */
+	*v = INTERSECT_DOT(dir, qvec) * inv_det;
+	if (*v < (Real)0 || *u + *v > (Real)1)
+		return 0;
+
+	/* calculate t, ray intersects triangle */
+	*t = INTERSECT_DOT(edge2, qvec) * inv_det;
+
+	return 1;
+}
+
+/**
+ @brief	Intersect sphere.
+
+ @param	orig  	The ray origin.
+ @param	dir   	The ray direction.
+ @param	radius	The sphere radius.
+ @param	centre	The sphere origin.
+
+ @return	The distance to where the ray enters the sphere, 0 if it misses.
+ */
+INTERSECT_FUNCTION
+Real intersectSphere(const Real orig[3], const Real dir[3], Real radius, const Real centre[3])
+{
+	Real L[3];
+	INTERSECT_SUB(L, centre, orig);
+	Real tca = INTERSECT_DOT(L, dir);
+
+	if (tca < (Real)0)
+	{
+		return (Real)0;
+	}
+
+	Real distanceSquared = INTERSECT_DOT(L, L) - tca * tca;
+	Real radiusSquared = radius * radius;
+
+	if (distanceSquared > radiusSquared)
+	{
+		return (Real)0;
+	}
+
+	Real thc = INTERSECT_SQRT(radiusSquared - distanceSquared);
+	return tca - thc;
+}
+
+/**
+ @brief	Normalise a number between zero and one.
+
+ @param	numberToNormalise	The number to normalise.
+ @param	max				 	The maximum.
+ @param	min				 	The minimum.
+
+ @return	The normalised number.
+ */
+INTERSECT_FUNCTION
+Real normaliseFloat(Real numberToNormalise, Real max, Real min)
+{
+	return (numberToNormalise - min) / (max - min);
+}
+
+/**
+ @brief	Gets how much of an object's colour is seen at a distance, nearer objects are brighter.
+
+ @param	distance	The distance to the hit.
+
+ @return	The scale to multiply the colour by, 255 up close down to 0 at a distance of 180.
+ */
+INTERSECT_FUNCTION
+Real shadeDistance(Real distance)
+{
+	return (Real)255 - (normaliseFloat(distance, (Real)180, (Real)0) * (Real)255);
+}
+
+/**
+ @brief	Slab test against a BVH node's box.
+	The intersection tests accept hits behind the ray origin so the near limit is unbounded.
+
+ @param 	   	boundsMin	  	The minimum corner of the box.
+ @param 	   	boundsMax	  	The maximum corner of the box.
+ @param 	   	orig		  	The ray origin.
+ @param 	   	dir			  	The ray direction.
+ @param 	   	maxDistance	  	Hits further than this (e.g. the closest hit so far) are ignored.
+ @param [out]	entryDistance	The distance the ray enters the box at, only set on a hit.
+
+ @return	1 if the ray passes through the box before maxDistance or 0 if not.
+ */
+INTERSECT_FLOAT_FUNCTION
+int intersectBounds(const float boundsMin[3], const float boundsMax[3], const float orig[3], const float dir[3],
+	float maxDistance, float *entryDistance)
+{
+	float tNear = -INTERSECT_FLT_MAX;
+	float tFar = maxDistance;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (dir[axis] == 0.0f)
+		{
+			//Ray runs parallel to this slab so it must start inside it
+			if (orig[axis] < boundsMin[axis] || orig[axis] > boundsMax[axis])
+				return 0;
+
+			continue;
+		}
+
+		float invDir = 1.0f / dir[axis];
+		float t0 = (boundsMin[axis] - orig[axis]) * invDir;
+		float t1 = (boundsMax[axis] - orig[axis]) * invDir;
+
+		if (t0 > t1)
+		{
+			float swap = t0;
+			t0 = t1;
+			t1 = swap;
+		}
+
+		//Written out rather than fmin/fmax so both sides treat NaN the same way
+		tNear = (tNear < t0) ? t0 : tNear;
+		tFar = (t1 < tFar) ? t1 : tFar;
+
+		if (tNear > tFar)
+			return 0;
+	}
+
+	*entryDistance = tNear;
+	return 1;
+}
+
+/**
+ @brief	Pushes the children of an interior BVH node onto the traversal stack, the nearer one last
+	so it is visited first and the far one can often be skipped. Ties visit the left child first.
+
+ @param [in,out]	stack	  	The node indices still to visit.
+ @param [in,out]	stackEntry	The distance the ray enters each node on the stack at.
+ @param [in,out]	stackSize 	Number of nodes on the stack.
+ @param 			left	  	Index of the left child, the right child follows it.
+ @param 			hitLeft   	1 if the ray hit the left child.
+ @param 			leftEntry 	The distance the ray enters the left child at.
+ @param 			hitRight  	1 if the ray hit the right child.
+ @param 			rightEntry	The distance the ray enters the right child at.
+ */
+INTERSECT_FLOAT_FUNCTION
+void pushChildren(int stack[], float stackEntry[], int *stackSize,
+	int left, int hitLeft, float leftEntry, int hitRight, float rightEntry)
+{
+	if (hitLeft && hitRight && leftEntry <= rightEntry)
+	{
+		stack[*stackSize] = left + 1;
+		stackEntry[(*stackSize)++] = rightEntry;
+		stack[*stackSize] = left;
+		stackEntry[(*stackSize)++] = leftEntry;
+	}
+	else if (hitLeft && hitRight)
+	{
+		stack[*stackSize] = left;
+		stackEntry[(*stackSize)++] = leftEntry;
+		stack[*stackSize] = left + 1;
+		stackEntry[(*stackSize)++] = rightEntry;
+	}
+	else if (hitLeft)
+	{
+		stack[*stackSize] = left;
+		stackEntry[(*stackSize)++] = leftEntry;
+	}
+	else if (hitRight)
+	{
+		stack[*stackSize] = left + 1;
+		stackEntry[(*stackSize)++] = rightEntry;
+	}
+}
+
+/**
+ @brief	Query if a hit should replace the closest one found so far. Ties go to the lowest primitive index,
+	which is the one the old linear loop over every primitive would have kept.
+
+ @param	distance			The distance to the hit.
+ @param	primitive			The primitive hit.
+ @param	closest				The distance to the closest hit so far.
+ @param	closestPrimitive	The primitive of the closest hit so far, -1 if none.
+
+ @return	1 if the hit is closer or 0 if not.
+ */
+INTERSECT_FLOAT_FUNCTION
+int isCloserHit(float distance, int primitive, float closest, int closestPrimitive)
+{
+	return distance < closest || (distance == closest && primitive < closestPrimitive);
+}
+
+#ifndef __OPENCL_VERSION__
+}
+#endif
+
+#undef INTERSECT_FUNCTION
+#undef INTERSECT_FLOAT_FUNCTION
+#undef INTERSECT_SQRT
+#undef INTERSECT_FLT_MAX
+#undef INTERSECT_CROSS
+#undef INTERSECT_DOT
+#undef INTERSECT_SUB
+
+#endif
@@ -1,16 +1,5 @@
 
-//Macros
-// Ref: http://cs.lth.se/tomas_akenine-moller
-#define EPSILON 0.000001
-#define CROSS(dest,v1,v2) \
-          dest[0]=v1[1]*v2[2]-v1[2]*v2[1]; \
-          dest[1]=v1[2]*v2[0]-v1[0]*v2[2]; \
-          dest[2]=v1[0]*v2[1]-v1[1]*v2[0];
-#define DOT(v1,v2) (v1[0]*v2[0]+v1[1]*v2[1]+v1[2]*v2[2])
-#define SUB(dest,v1,v2) \
-          dest[0]=v1[0]-v2[0]; \
-          dest[1]=v1[1]-v2[1]; \
-          dest[2]=v1[2]-v2[2];
+//The intersection tests, BVH traversal steps and shadeDistance come from Intersect.h, which the host puts in front of this file
 
 struct Ray
 {
@@ -24,99 +13,57 @@ struct Sphere
 	int radius;
 };
 
-float normaliseFloat(float numberToNormalise, float max, float min)
+//Must match the layout of BVHNode in BVH.h
+struct BVHNode
 {
-	//normalise the number between zero and one
-	float normalisedNumber = (numberToNormalise - min) / (max - min);
-
-	//return the normalised number
-	return normalisedNumber;
-}
-
-//Ref: http://cs.lth.se/tomas_akenine-moller
-int intersectTri(float orig[3], float dir[3],
-	float vert0[3], float vert1[3], float vert2[3],
-	float *t, float *u, float *v)
-{
-	float edge1[3], edge2[3], tvec[3], pvec[3], qvec[3];
-	float det, inv_det;
-
-	/* find vectors for two edges sharing vert0 */
-	SUB(edge1, vert1, vert0);
-	SUB(edge2, vert2, vert0);
-
-	/* begin calculating determinant - also used to calculate U parameter */
-	CROSS(pvec, dir, edge2);
-
-	/* if determinant is near zero, ray lies in plane of triangle */
-	det = DOT(edge1, pvec);
-
-	if (det > -EPSILON && det < EPSILON)
-		return 0;
-	inv_det = 1.0 / det;
-
-	/* calculate distance from vert0 to ray origin */
-	SUB(tvec, orig, vert0);
-
-	/* calculate U parameter and test bounds */
-	*u = DOT(tvec, pvec) * inv_det;
-	if (*u < 0.0 || *u > 1.0)
-		return 0;
-
-	/* prepare to test V parameter */
-	CROSS(qvec, tvec, edge1);
+	float boundsMin[3];
+	int leftOrFirst;
+	float boundsMax[3];
+	int primitiveCount;
+};
 
-	/* calculate V parameter and test bounds */
-	*v = DOT(dir, qvec) * inv_det;
-	if (*v < 0.0 || *u + *v > 1.0)
-		return 0;
+//BVH_MAX_DEPTH is passed in as a build option from BVH::MAX_DEPTH
+#ifndef BVH_MAX_DEPTH
+#define BVH_MAX_DEPTH 32
+#endif
 
-	/* calculate t, ray intersects triangle */
-	*t = DOT(edge2, qvec) * inv_det;
+//TRIANGLE_STRIDE_MULTIPLE is passed in as a build option from TriangleStore::STRIDE_MULTIPLE
+#ifndef TRIANGLE_STRIDE_MULTIPLE
+#define TRIANGLE_STRIDE_MULTIPLE 8
+#endif
 
-	return 1;
-}
+//Component arrays of the triangle store, must match the order of TriangleStore::Component
+#define TRIANGLE_VERTEX0 0
+#define TRIANGLE_EDGE1 3
+#define TRIANGLE_EDGE2 6
 
-float intersectSphere(float4 rayOrigin, float4 rayDir, float sphereRadius, float4 sphereOrigin)
+//Slab test against a node's box, the shared test takes private memory so the bounds are copied out first
+int intersectNode(__global const struct BVHNode* node, float orig[3], float dir[3], float maxDistance, float* entryDistance)
 {
-	//Light Dir
-	float4 L = sphereOrigin - rayOrigin;
-	float tca = dot(L, rayDir);
+	float boundsMin[3] = { node->boundsMin[0], node->boundsMin[1], node->boundsMin[2] };
+	float boundsMax[3] = { node->boundsMax[0], node->boundsMax[1], node->boundsMax[2] };
 
-	if (tca < 0)
-	{
-		return 0.0f;
-	}
-
-	float distanceSquared = dot(L, L) - tca * tca;
-	float radiusSquared = sphereRadius * sphereRadius;
-
-	if (distanceSquared > radiusSquared)
-	{
-		return 0.0f;
-	}
-
-	float thc = sqrt((radiusSquared) - distanceSquared);
-
-	//Calculate sphere entry and exit distance
-	float t0 = tca - thc;
-	float t1 = tca + thc;
-
-	//return distance(t0, t1);
-	return t0;
-
-	//distance = normaliseFloat(distance, s.radius + s.radius, 0.0f) * 255.0f;
+	return intersectBounds(boundsMin, boundsMax, orig, dir, maxDistance, entryDistance);
 }
 
-__kernel void rayTracer(__global int* output,
+__kernel void rayTracer(__global uchar4* output,
 	int numSpheres, __global float4* sphereOrigins, __global float* sphereRadius, __global float4* sphereColours,
-	int numCubes, __global float4* cubeVertices, __global float4* cubeColours,
-	__global float4* rayOrigins, float4 rayDir)
+	int numCubes, __global const float* triangles, __global float4* cubeColours,
+	int width, float4 rayDir,
+	int numNodes, __global const struct BVHNode* nodes, __global const int* primitiveIndices,
+	int height)
 {
+	//The range is rounded up to whole work-groups so some work items are past the edge of the image
+	int x = get_global_id(0);
+	int y = get_global_id(1);
+	if (x >= width || y >= height)
+		return;
+
 	float4 result = (float4)(0.0f,0.0f,0.0f,255.0f);
 
 	struct Ray ray;
-	ray.origin = rayOrigins[get_global_id(0)];
+	//The rays are parallel so each one starts at its pixel, must match RayTracer::getRayOrigin
+	ray.origin = (float4)((float)x, (float)y, 0.0f, 1.0f);
  	ray.direction = rayDir;
 
 	const unsigned int numOfTrianglesPerCube = 12;
@@ -126,8 +73,8 @@ __kernel void rayTracer(__global int* output,
 	float rayDirConverted[3] = { ray.direction.x, ray.direction.y, ray.direction.z };
 
 	float tri0[3];
-	float tri1[3];
-	float tri2[3];
+	float edge1[3];
+	float edge2[3];
 
 	float t = 0;
 	float u = 0;
@@ -136,51 +83,91 @@ __kernel void rayTracer(__global int* output,
 	float4 closestColour = (float4)(0.0f, 0.0f, 0.0f, 255.0f);
 	float closest = 300000.0f; //Set to high number so it will always be beaten
 
-	//Process Cubes
-	for (unsigned int cubeIndex = 0; cubeIndex < numCubes; cubeIndex++)
+	const int numTriangles = numCubes * numOfTrianglesPerCube;
+	int closestPrimitive = -1;
+
+	//Each component of the triangles is its own array, padded so the next one stays aligned
+	const int triangleStride = ((numTriangles + TRIANGLE_STRIDE_MULTIPLE - 1) / TRIANGLE_STRIDE_MULTIPLE) * TRIANGLE_STRIDE_MULTIPLE;
+
+	//Nodes still to visit and the distance the ray enters them at
+	int stack[BVH_MAX_DEPTH];
+	float stackEntry[BVH_MAX_DEPTH];
+	int stackSize = 0;
+
+	float entry = 0.0f;
+	if (numNodes > 0 && intersectNode(&nodes[0], rayOriginConverted, rayDirConverted, closest, &entry))
+	{
+		stack[stackSize] = 0;
+		stackEntry[stackSize] = entry;
+		stackSize++;
+	}
+
+	while (stackSize > 0)
 	{
-		//Due to all cubes triangles being in the same array,
-		//I offset the triangle indexes by the current cube index
-		unsigned int triOffset = cubeIndex * numOfTrianglesPerCube * 3;
+		stackSize--;
+
+		//A closer hit may have been found since this node was pushed
+		if (stackEntry[stackSize] > closest)
+			continue;
+
+		__global const struct BVHNode* node = &nodes[stack[stackSize]];
 
-		for (unsigned int triIndex = 0; triIndex < numOfTrianglesPerCube * 3; triIndex += 3)
+		if (node->primitiveCount == 0)
 		{
-			tri0[0] = cubeVertices[triOffset + triIndex].x;
-			tri0[1] = cubeVertices[triOffset + triIndex].y;
-			tri0[2] = cubeVertices[triOffset + triIndex].z;
+			int left = node->leftOrFirst;
+			float leftEntry = 0.0f;
+			float rightEntry = 0.0f;
+			int hitLeft = intersectNode(&nodes[left], rayOriginConverted, rayDirConverted, closest, &leftEntry);
+			int hitRight = intersectNode(&nodes[left + 1], rayOriginConverted, rayDirConverted, closest, &rightEntry);
+			pushChildren(stack, stackEntry, &stackSize, left, hitLeft, leftEntry, hitRight, rightEntry);
 
-			tri1[0] = cubeVertices[triOffset + triIndex + 1].x;
-			tri1[1] = cubeVertices[triOffset + triIndex + 1].y;
-			tri1[2] = cubeVertices[triOffset + triIndex + 1].z;
+			continue;
+		}
 
-			tri2[0] = cubeVertices[triOffset + triIndex + 2].x;
-			tri2[1] = cubeVertices[triOffset + triIndex + 2].y;
-			tri2[2] = cubeVertices[triOffset + triIndex + 2].z;
+		for (int i = 0; i < node->primitiveCount; i++)
+		{
+			int primitive = primitiveIndices[node->leftOrFirst + i];
+			float distance = 0.0f;
 
-			if (intersectTri(rayOriginConverted, rayDirConverted, tri0, tri1, tri2, &t, &u, &v) == 1)
+			if (primitive < numTriangles)
 			{
-				if ((float)t < closest)
+				for (int axis = 0; axis < 3; axis++)
 				{
-					closest = (float)t;
-					closestColour = cubeColours[cubeIndex];
+					tri0[axis] = triangles[(TRIANGLE_VERTEX0 + axis) * triangleStride + primitive];
+					edge1[axis] = triangles[(TRIANGLE_EDGE1 + axis) * triangleStride + primitive];
+					edge2[axis] = triangles[(TRIANGLE_EDGE2 + axis) * triangleStride + primitive];
 				}
+
+				if (intersectTriangle(rayOriginConverted, rayDirConverted, tri0, edge1, edge2, &t, &u, &v) != 1)
+					continue;
+
+				distance = t;
+			}
+			else
+			{
+				int sphereIndex = primitive - numTriangles;
+				float4 sphereOrigin = sphereOrigins[sphereIndex];
+				float sphereCentre[3] = { sphereOrigin.x, sphereOrigin.y, sphereOrigin.z };
+				distance = intersectSphere(rayOriginConverted, rayDirConverted, sphereRadius[sphereIndex], sphereCentre);
+
+				if (distance == 0.0f)
+					continue;
+			}
+
+			if (isCloserHit(distance, primitive, closest, closestPrimitive))
+			{
+				closest = distance;
+				closestPrimitive = primitive;
 			}
 		}
 	}
 
-	//Process Spheres
-	for (unsigned int sphereIndex = 0; sphereIndex < numSpheres; sphereIndex++)
+	if (closestPrimitive != -1)
 	{
-		float distance = intersectSphere(ray.origin, ray.direction, sphereRadius[sphereIndex], sphereOrigins[sphereIndex]);
-
-		if (distance == 0.0f)
-			continue;
-
-		if (distance < closest)
-		{
-			closest = distance;
-			closestColour = sphereColours[sphereIndex];
-		}
+		if (closestPrimitive < numTriangles)
+			closestColour = cubeColours[closestPrimitive / numOfTrianglesPerCube];
+		else
+			closestColour = sphereColours[closestPrimitive - numTriangles];
 	}
 
 	//Check any object is closer than the default setting, if not return black colour as no intersects occurred
@@ -190,13 +177,15 @@ __kernel void rayTracer(__global int* output,
 	}
 	else
 	{
-		float colourScalar = 255.0f - (normaliseFloat(closest, 180.0f, 0.0f) * 255.0f);
+		float colourScalar = shadeDistance(closest);
 		result = colourScalar * closestColour;
 		result.w = 255.0f;
 	}
 
-	output[(get_global_id(0) * 4)	 ] = result.x;
-	output[(get_global_id(0) * 4) + 1] = result.y;
-	output[(get_global_id(0) * 4) + 2] = result.z;
-	output[(get_global_id(0) * 4) + 3] = result.w;
+	//Packed RGBA8, truncated then wrapped the same way the host narrows its colours
+	output[(y * width) + x] = (uchar4)(
+		(uchar)(int)result.x,
+		(uchar)(int)result.y,
+		(uchar)(int)result.z,
+		(uchar)(int)result.w);
 }